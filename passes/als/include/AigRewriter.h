@@ -0,0 +1,90 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Rewriting of LUTs as AIGs for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_AIGREWRITER_H
+#define YOSYS_ALS_AIGREWRITER_H
+
+#include "smtsynth.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <utility>
+
+namespace yosys_als {
+
+/**
+ * @brief Replaces the LUTs of a module with the gates of their AIG models
+ * The rewriter works as an AIG manager with complemented edges over the whole module: AND gates
+ * with the same fan-ins are created once and shared by all the LUTs, constants are propagated,
+ * and an inverter is only created for a signal that is actually used complemented, once.
+ */
+class AigRewriter {
+public:
+    /**
+     * @brief Constructs a rewriter
+     * @param module The module whose LUTs are rewritten
+     */
+    explicit AigRewriter(Yosys::Module *module);
+
+    /**
+     * @brief Replaces a LUT with the gates of an AIG model
+     * @param lut A LUT cell of the module
+     * @param aig An AIG model of the LUT specification
+     */
+    void replace(Yosys::Cell *lut, const aig_model_t &aig);
+
+    /**
+     * @brief Gets the number of gates created so far
+     * @return The number of AND gates and inverters
+     */
+    size_t gates() const;
+
+private:
+    /// A literal, i.e. a signal and a flag that is \c true if it is complemented
+    typedef std::pair<Yosys::SigBit, bool> lit_t;
+
+    Yosys::Module *module;
+    Yosys::SigMap sigmap;
+    Yosys::dict<std::pair<lit_t, lit_t>, Yosys::SigBit> and_gates;
+    Yosys::dict<Yosys::SigBit, Yosys::SigBit> inverters;
+
+    lit_t literal(const Yosys::SigBit &bit) const;
+
+    lit_t make_and(lit_t a, lit_t b);
+
+    Yosys::SigBit signal(const lit_t &lit);
+};
+}
+
+#endif //YOSYS_ALS_AIGREWRITER_H
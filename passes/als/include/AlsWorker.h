@@ -25,13 +25,17 @@
 #ifndef YOSYS_ALS_ALSWORKER_H
 #define YOSYS_ALS_ALSWORKER_H
 
+#include "Catalogue.h"
 #include "Optimizer.h"
+#include "distribution.h"
 #include "smtsynth.h"
+#include "variants.h"
 
 #include "kernel/yosys.h"
 
-#include <sqlite3.h>
+#include <boost/optional.hpp>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -51,8 +55,11 @@ public:
     /// The metric to be used for evaluation @todo make a pointer to class
     std::string metric;
 
-    /// Weights for the outputs
-    weights_t weights;
+    /// Weights for the outputs of each module, by name
+    Yosys::dict<Yosys::IdString, weights_t> weights;
+
+    /// Distributions of the inputs of each module, by name
+    Yosys::dict<Yosys::IdString, distributions_t> distributions;
 
     /// Maximum number of iterations for the optimizer
     size_t max_iter{};
@@ -63,44 +70,110 @@ public:
     /// Number of test vectors to be evaluated
     size_t test_vectors_n{};
 
+    /// Number of test vectors of each step of the sequential evaluation of the error, or 0 not to stop early
+    size_t batch_size = 256;
+
+    /// If \c true, neighbors are screened by an analytical estimate of the error
+    bool screen = false;
+
+    /// Path of the catalogue of synthesized LUTs
+    std::string catalogue_path = "catalogue.db";
+
+    /// Seed of the random number generator, if any
+    boost::optional<unsigned long> seed;
+
+    /// If \c true, do not reuse the results of previous runs on the same module with the same options
+    bool rerun = false;
+
+    /// Path of the directory of results of previous runs
+    std::string result_cache_path = ".als_cache";
+
+    /// If \c true, switching power is an objective of the optimizer besides error and gates
+    bool power_objective = false;
+
+    /// If \c true, map each variant to 6-input LUTs to estimate its size and depth
+    bool estimate = false;
+
+    /// If \c true, keep the golden outputs of the evaluator in a memory-mapped file among the results
+    bool map_golden = false;
+
+    /// Maximum number of LUTs of a window, modules with more LUTs are partitioned, or 0 not to partition
+    size_t window_size = 0;
+
     /// Index of the synthesized LUTs
     Yosys::dict<Yosys::Const, std::vector<aig_model_t>> synthesized_luts;
 
     /**
-     * Runs an ALS step on selected module
-     * @param module A module
+     * Runs an ALS step on selected modules
+     * The modules are mapped and restored one at a time, synthesized together and optimized in concurrent processes.
+     * @param modules The modules
      */
-    void run(Yosys::Module *const module);
+    void run(const std::vector<Yosys::Module *> &modules);
 
 private:
-    sqlite3 *db = nullptr;
+    /// The state of the run on a module
+    struct job_t {
+        Yosys::Module *module = nullptr;
+        std::string key;
+        std::string cache_dir;
+        std::string mapped;
+        std::string log_string;
+        std::vector<variant_t> variants;
+        bool restored = false;
+        std::unique_ptr<Yosys::Design> window_design;
+        std::vector<Yosys::Module *> windows;
+        std::vector<std::string> fronts;
+    };
+
+    std::unique_ptr<Catalogue> catalogue;
 
     template<typename E>
     static std::string print_archive(const Optimizer<E> &opt, const archive_t<E> &arch) {
         std::string log_string;
-        log_string.append(" Entry     Chosen LUTs         Arel        Gates\n");
-        log_string.append(" ----- --------------- ------------ ------------\n");
+        log_string.append(" Entry         Arel        Gates        Power Chosen LUTs\n");
+        log_string.append(" ----- ------------ ------------ ------------ -----------\n");
 
+        // Levels may take more than a digit, so the chosen LUTs are last and never truncated
         char log_line_buffer[60];
         for (size_t i = 0; i < arch.size(); i++) {
-            auto choice_s = opt.to_string(arch[i].first);
-            if (choice_s.size() > 15) {
-                choice_s = choice_s.substr(0, 15);
-            }
-            snprintf(log_line_buffer, sizeof(log_line_buffer), " %5zu %15s %12g %12g\n",
-                     i, choice_s.c_str(), arch[i].second[0], arch[i].second[1]);
+            snprintf(log_line_buffer, sizeof(log_line_buffer), " %5zu %12g %12g %12g ",
+                     i, arch[i].second[0], arch[i].second[1], opt.power(arch[i].first));
             log_string.append(log_line_buffer);
+            log_string.append(opt.to_string(arch[i].first));
+            log_string.append("\n");
         }
 
         return log_string;
     }
 
-    void replace_lut(Yosys::Module *const module, Yosys::Cell *const lut, const aig_model_t &aig);
+    void open_catalogue();
+
+    void close_catalogue();
+
+    void rewrite_luts(Yosys::Module *const module);
+
+    void exact_synthesis_helper(const std::vector<Yosys::Module *> &modules);
+
+    void partition(job_t &job) const;
 
-    void exact_synthesis_helper(Yosys::Module *module);
+    std::string optimize_job(const job_t &job, const size_t window);
 
     template<typename E>
-    std::string optimizeAndRewrite(Yosys::Module *const module, typename E::parameters_t parameters);
+    std::string optimize(const job_t &job, const size_t window, typename E::parameters_t parameters);
+
+    void write_variants(Yosys::Module *const module, const std::vector<variant_t> &variants,
+                        const std::string &log_string);
+
+    void estimate_luts(Yosys::Module *const module, std::vector<variant_t> &variants) const;
+
+    std::string result_key(Yosys::Module *const module) const;
+
+    Yosys::Module *restore_results(Yosys::Module *module, const std::string &dir, const std::string &key,
+                                   std::vector<variant_t> &variants, std::string &log_string);
+
+    void save_results(Yosys::Module *const module, const std::string &dir, const std::string &key,
+                      const std::string &mapped, const std::vector<variant_t> &variants,
+                      const std::string &log_string) const;
 };
 
 }
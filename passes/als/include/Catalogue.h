@@ -0,0 +1,353 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Cache of synthesized LUTs for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_CATALOGUE_H
+#define YOSYS_ALS_CATALOGUE_H
+
+#include "Snapshot.h"
+#include "smtsynth.h"
+
+#include <sqlite3.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Statistics of the catalogue for a given arity and distance
+ */
+struct catalogue_stats_t {
+    /// Number of stored models
+    size_t entries = 0;
+
+    /// Number of stored models that are proven minimal
+    size_t optimal = 0;
+
+    /// Number of stored models and time-outs of older encodings
+    size_t stale = 0;
+
+    /// Number of recorded time-outs of the current encoding
+    size_t timeouts = 0;
+
+    /// Size of the stored models, in bytes
+    size_t bytes = 0;
+
+    /// Number of lookups that hit the catalogue
+    size_t hits = 0;
+
+    /// Number of lookups that missed the catalogue
+    size_t misses = 0;
+};
+
+/**
+ * @brief Persistent cache of synthesized LUTs
+ * Entries are keyed by \c <truth table>@<distance>. Syntheses that timed out are recorded too,
+ * together with the budget that was used, and are not retried with an equal or smaller budget.
+ * Models and time-outs are tagged with the SMT encoding version that produced them, and only those
+ * of the current version are used; models are also flagged as proven minimal or best found, and a
+ * stored model is only replaced by a better one. The whole database is read in a single
+ * sequential scan on first use and then served from an in-memory index, which can be shared
+ * between synthesis threads.
+ * The database can be shared by concurrent processes: writers wait on busy locks, and a process
+ * can claim a key with a lease, so that others wait for its result instead of synthesizing it.
+ * If a snapshot compiled from the database is found next to it, lookups go to the snapshot first,
+ * and the database is only queried for single entries that are missing from the snapshot.
+ * Writes can be deferred to a writer thread, which stores them in batched transactions, so that
+ * synthesis threads only update the index.
+ */
+class Catalogue {
+public:
+    /**
+     * @brief Opens a catalogue, creating it if needed
+     * @param path The path of the database file
+     * @param use_snapshot If \c true, use the snapshot of the database, if any
+     */
+    explicit Catalogue(const std::string &path, bool use_snapshot = true);
+
+    ~Catalogue();
+
+    Catalogue(const Catalogue &) = delete;
+
+    Catalogue &operator=(const Catalogue &) = delete;
+
+    /**
+     * @brief Looks up an entry
+     * @param key The key of the entry
+     * @param aig Set to the cached model on a hit
+     * @return \c true on a hit, otherwise \c false
+     */
+    bool lookup(const std::string &key, aig_model_t &aig);
+
+    /**
+     * @brief Looks up an entry in the database, bypassing the index
+     * Useful for entries written by other processes after the index was loaded.
+     * @param key The key of the entry
+     * @param aig Set to the cached model on a hit
+     * @return \c true on a hit, otherwise \c false
+     */
+    bool fetch(const std::string &key, aig_model_t &aig);
+
+    /**
+     * @brief Inserts an entry, if not already present with a model at least as good
+     * A model is better if it is proven minimal and the stored one is not, or if it has fewer gates.
+     * @param key The key of the entry
+     * @param aig The model to be cached
+     * @return \c false if the database could not be written, otherwise \c true
+     */
+    bool insert(const std::string &key, const aig_model_t &aig);
+
+    /**
+     * @brief Inserts a batch of entries in a single transaction, keeping the better models
+     * @param entries The entries, as key and model pairs
+     * @return \c false if the database could not be written, otherwise \c true
+     */
+    bool insert(const std::vector<std::pair<std::string, aig_model_t>> &entries);
+
+    /**
+     * @brief Checks if the synthesis of an entry is known to time out
+     * @param key The key of the entry
+     * @param max_tries The budget of the synthesis
+     * @return \c true if the synthesis already timed out with an equal or larger budget
+     */
+    bool timed_out(const std::string &key, unsigned int max_tries);
+
+    /**
+     * @brief Records that the synthesis of an entry timed out
+     * Only the largest budget is kept for each entry.
+     * @param key The key of the entry
+     * @param max_tries The budget of the synthesis
+     * @return \c false if the database could not be written, otherwise \c true
+     */
+    bool insert_timeout(const std::string &key, unsigned int max_tries);
+
+    /**
+     * @brief Records a batch of time-outs in a single transaction
+     * @param keys The keys of the entries
+     * @param max_tries The budget of the synthesis
+     * @return \c false if the database could not be written, otherwise \c true
+     */
+    bool insert_timeout(const std::vector<std::string> &keys, unsigned int max_tries);
+
+    /**
+     * @brief Claims the synthesis of an entry for this process
+     * A claim held by another process is honoured until its lease expires.
+     * @param key The key of the entry
+     * @return \c true if the claim is ours, otherwise \c false
+     */
+    bool claim(const std::string &key);
+
+    /**
+     * @brief Releases a claim of this process
+     * With deferred writes, the claim is released after the entries queued before it are stored.
+     * @param key The key of the entry
+     */
+    void release(const std::string &key);
+
+    /**
+     * @brief Waits until a claim held by another process is released or expires
+     * @param key The key of the entry
+     * @param aig Set to the cached model if the other process stored it
+     * @return \c true if the entry was stored, otherwise \c false
+     */
+    bool wait_for(const std::string &key, aig_model_t &aig);
+
+    /**
+     * @brief Defers the following writes to a writer thread
+     * Inserts and releases return as soon as they are queued. The queue is drained when the catalogue
+     * is closed, and before the operations that read the database as a whole.
+     */
+    void write_behind();
+
+    /**
+     * @brief Waits until the queued writes are stored
+     * @return \c false if some writes failed since the last flush, otherwise \c true
+     */
+    bool flush();
+
+    /**
+     * @brief Gets the number of entries in the index
+     * @return The number of entries
+     */
+    size_t size();
+
+    /**
+     * @brief Gets all the entries of the catalogue
+     * @return The entries, as key and model pairs
+     */
+    std::vector<std::pair<std::string, aig_model_t>> entries();
+
+    /**
+     * @brief Removes an entry
+     * @param key The key of the entry
+     */
+    void erase(const std::string &key);
+
+    /**
+     * @brief Counts a lookup for the hit rate statistics
+     * Counters are accumulated in the database when the catalogue is closed.
+     * @param key The key of the entry
+     * @param hit \c true if the lookup was a hit
+     */
+    void count(const std::string &key, bool hit);
+
+    /**
+     * @brief Gathers statistics of the catalogue
+     * @return The statistics, indexed by arity and distance
+     */
+    std::map<std::pair<unsigned int, unsigned int>, catalogue_stats_t> stats();
+
+    /**
+     * @brief Gets the size of the database file
+     * @return The size, in bytes
+     */
+    size_t file_size();
+
+    /**
+     * @brief Compiles all the entries to the snapshot of the database
+     * @return The number of entries in the snapshot
+     */
+    size_t write_snapshot();
+
+    /**
+     * @brief Gets the path of the snapshot of a database
+     * @param path The path of the database file
+     * @return The path of the snapshot file
+     */
+    static std::string snapshot_path(const std::string &path);
+
+    /**
+     * @brief Drops expired claims and compacts the database file
+     */
+    void vacuum();
+
+    /**
+     * @brief Removes the entries and time-outs of older SMT encodings
+     * @param suboptimal If \c true, also remove the models that are not proven minimal
+     * @return The number of removed entries and time-outs
+     */
+    size_t invalidate(bool suboptimal = false);
+
+    /**
+     * @brief Copies all the entries to a bundle, i.e. another catalogue file
+     * @param path The path of the bundle
+     * @return The number of exported entries
+     */
+    size_t export_bundle(const std::string &path);
+
+    /**
+     * @brief Merges the entries of a bundle, keeping the better models
+     * @param path The path of the bundle
+     * @return The number of imported entries
+     */
+    size_t import_bundle(const std::string &path);
+
+    /// Duration of a claim, in seconds
+    unsigned int lease = 600;
+
+    /// Maximum time spent waiting for a database lock, in milliseconds
+    static constexpr int busy_timeout = 60000;
+
+private:
+    sqlite3 *db = nullptr;
+    std::mutex db_mtx;
+    std::string path;
+    std::string owner;
+
+    std::unique_ptr<Snapshot> snapshot;
+
+    bool loaded = false;
+    std::mutex index_mtx;
+    std::unordered_map<std::string, aig_model_t> index;
+    std::unordered_map<std::string, unsigned int> timeouts;
+
+    std::thread writer;
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;
+    std::condition_variable drained_cv;
+    std::vector<std::pair<std::string, aig_model_t>> queued_luts;
+    std::vector<std::pair<std::string, unsigned int>> queued_timeouts;
+    std::vector<std::string> queued_releases;
+    bool writing = false;
+    bool stopping = false;
+    size_t failed_writes = 0;
+
+    std::mutex usage_mtx;
+    std::map<std::pair<unsigned int, unsigned int>, std::pair<size_t, size_t>> usage;
+
+    void preload();
+
+    void drain();
+
+    bool write_luts(const std::vector<std::pair<std::string, aig_model_t>> &entries);
+
+    bool write_timeouts(const std::vector<std::pair<std::string, unsigned int>> &entries);
+
+    void write_release(const std::string &key);
+
+    void create_tables(const std::string &schema);
+
+    bool has_column(const std::string &schema, const std::string &table, const std::string &column);
+
+    size_t merge(const std::string &from, const std::string &to);
+
+    static void bind_lut(sqlite3_stmt *stmt, const std::string &key, const aig_model_t &aig);
+
+    void exec(const std::string &query);
+
+    void flush_usage();
+};
+
+/**
+ * @brief Serializes an AIG model to its catalogue representation
+ * @param aig An AIG model
+ * @return The serialized model
+ */
+std::string aig_to_string(const aig_model_t &aig);
+
+/**
+ * @brief Deserializes an AIG model from its catalogue representation
+ * @param s The serialized model
+ * @return An AIG model
+ */
+aig_model_t aig_from_string(const std::string &s);
+
+/**
+ * @brief Splits a catalogue key in its components
+ * @param key A key
+ * @param arity Set to the arity of the specification
+ * @param distance Set to the distance
+ * @return \c false if the key is malformed, otherwise \c true
+ */
+bool parse_key(const std::string &key, unsigned int &arity, unsigned int &distance);
+}
+
+#endif //YOSYS_ALS_CATALOGUE_H
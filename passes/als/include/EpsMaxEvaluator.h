@@ -26,6 +26,10 @@
 #define YOSYS_ALS_EPSMAXEVALUATOR_H
 
 #include "Optimizer.h"
+#include "OutputMatrix.h"
+#include "bitslice.h"
+
+#include <map>
 
 namespace yosys_als {
 
@@ -54,12 +58,45 @@ public:
      */
     value_t value(const solution_t &s) const;
 
+    /**
+     * @brief Evaluates a solution to be compared with another one
+     * The error is evaluated on all the input vectors anyway, so the reference is not used.
+     * @param s The solution
+     * @param reference The solution it is compared with
+     * @param partial Set to \c false, as values are never partial
+     */
+    value_t value(const solution_t &s, const archive_entry_t<EpsMaxEvaluator> &reference, bool &partial) const;
+
     /**
      * @brief Evaluates a solution that is known to be an empty solution
      * @param s The solution
      */
     static value_t empty_solution_value(const solution_t &s);
 
+    /**
+     * @brief Evaluates the fidelity of the error of a solution
+     * @param s The solution
+     */
+    fidelity_t fidelity(const solution_t &s) const;
+
+    /**
+     * @brief Evaluates the magnitude of the error of a solution
+     * The weighted outputs of 64 input vectors are compared at once by bit-sliced arithmetic, and the
+     * maximum, sum and histogram of the absolute differences are reduced in the same pass.
+     * @param s The solution
+     * @return The reductions of the error on all the input vectors
+     */
+    sliced_stats_t error_stats(const solution_t &s) const;
+
+    /**
+     * @brief Estimates the switching power of a solution
+     * The estimate is the number of gates of each LUT weighted by the toggles of its output between
+     * consecutive random input vectors.
+     * @param s The solution
+     * @return The ratio of the estimate to that of the exact circuit
+     */
+    double power(const solution_t &s) const;
+
     /**
      * @brief Checks if a solution dominates another
      * @param s1 A solution
@@ -92,19 +129,28 @@ private:
 
     // Private solution evaluation data
     size_t gates_baseline;
+    size_t output_width = 0;
+    std::vector<boost::dynamic_bitset<>> activity_vectors;
+    mutable double activity_baseline = -1.0;
+
+    // Parameters
+    size_t activity_vectors_n = 1000;
 
     // Execution data
     unsigned processor_count;
 
     // Private evaluation methods
-    double circuit_epsmax(const solution_t &s) const;
+    double switching_activity(const solution_t &s) const;
 
     boost::dynamic_bitset<> evaluate_graph(const solution_t &s,
-                                           const boost::dynamic_bitset<> &input) const;
+                                           const boost::dynamic_bitset<> &input,
+                                           std::map<vertex_d, bool> *cell_values = nullptr) const;
+
+    sliced_t evaluate_words(const solution_t &s, size_t block) const;
 
     size_t gates(const solution_t &s) const;
 
-    std::vector<boost::dynamic_bitset<>> exact_outputs;
+    OutputMatrix exact_outputs;
 };
 
 }
@@ -27,23 +27,39 @@
 
 #include "Optimizer.h"
 
+#include "OutputMatrix.h"
+#include "bitslice.h"
+#include "distribution.h"
 #include "graph.h"
 
 #include <boost/dynamic_bitset.hpp>
 
 #include <array>
+#include <map>
 
 namespace yosys_als {
 
 class ErSEvaluator {
 public:
-    /// Type for the value of the solution
-    typedef std::array<double, 2> value_t;
+    /// Type for the value of the solution, i.e. error, gates and switching power
+    typedef std::array<double, 3> value_t;
 
     /// Parameters for an optimizer based on this evaluator
     struct parameters_t : public optimizer_parameters_t {
         /// Number of test vectors to be evaluated
         int test_vectors_n = 1000;
+
+        /// If \c true, switching power is the third objective, otherwise it is always zero
+        bool power_objective = false;
+
+        /// Distributions of the inputs, or \c nullptr if all the inputs are uniform
+        const distributions_t *distributions = nullptr;
+
+        /// Number of test vectors of each step of the sequential evaluation of the error, or 0 not to stop early
+        size_t batch_size = 256;
+
+        /// If \c true, compared solutions are screened by an analytical estimate of the error
+        bool screen = false;
     };
 
     /**
@@ -59,15 +75,49 @@ public:
 
     /**
      * @brief Evaluates a solution
+     * The error is always given by simulation on all the test vectors.
      * @param s The solution
      */
     value_t value(const solution_t &s) const;
 
+    /**
+     * @brief Evaluates a solution to be compared with another one
+     * The error is evaluated sequentially, on batches of test vectors in random order, until its
+     * confidence interval excludes the error of the reference, as the comparison is decided then.
+     * Before that, the flip and observability signatures of the LUTs bound the error without any
+     * simulation, and give it exactly when a single LUT differs from the exact circuit. Vectors flipped
+     * by more than one LUT, or whose flip reaches another LUT that differs, are left unknown. Only close
+     * calls are evaluated on all the test vectors.
+     * When screening, the error and the switching power are estimated analytically instead, within
+     * the bounds of the signatures, which hold also when the LUTs interact.
+     * Values decided by bounds, by part of the test vectors or by screening are partial, and must be
+     * evaluated in full before the solution is archived.
+     * @param s The solution
+     * @param reference The solution it is compared with
+     * @param partial Set to \c true if the value is partial, otherwise to \c false
+     */
+    value_t value(const solution_t &s, const archive_entry_t<ErSEvaluator> &reference, bool &partial) const;
+
     /**
      * @brief Evaluates a solution that is known to be an empty solution
      * @param s The solution
      */
-    static value_t empty_solution_value(const solution_t &s);
+    value_t empty_solution_value(const solution_t &s) const;
+
+    /**
+     * @brief Evaluates the fidelity of the error of a solution
+     * @param s The solution
+     */
+    fidelity_t fidelity(const solution_t &s) const;
+
+    /**
+     * @brief Estimates the switching power of a solution
+     * The estimate is the number of gates of each LUT weighted by the toggles of its output between
+     * consecutive test vectors, in random order.
+     * @param s The solution
+     * @return The ratio of the estimate to that of the exact circuit
+     */
+    double power(const solution_t &s) const;
 
     /**
      * @brief Checks if a solution dominates another
@@ -89,13 +139,27 @@ public:
                             const archive_entry_t<ErSEvaluator> &s2) {
         double f1 = fabs(s1.second[0] - s2.second[0]);
         double f2 = fabs(s1.second[1] - s2.second[1]);
+        double f3 = fabs(s1.second[2] - s2.second[2]);
         f1 = f1 != 0.0 ? f1 : 1.0;
         f2 = f2 != 0.0 ? f2 : 1.0;
+        f3 = f3 != 0.0 ? f3 : 1.0;
 
-        return f1 * f2;
+        return f1 * f2 * f3;
     }
 
 private:
+    /// Signatures of a LUT on the test vectors, one bit per vector
+    struct signature_t {
+        /// Vectors on which a flip of the output of the LUT reaches a primary output of the exact circuit
+        std::vector<uint64_t> observable;
+
+        /// Vectors on which the output of each level differs from the exact one, on exact inputs
+        std::vector<std::vector<uint64_t>> flips;
+
+        /// Cells whose inputs a flip of the output of the LUT changes on some vector, sorted
+        std::vector<Yosys::IdString> reached;
+    };
+
     // The optimizer context
     optimizer_context_t<ErSEvaluator> *ctx;
 
@@ -103,10 +167,26 @@ private:
     double rel_norm;
     size_t gates_baseline;
     std::vector<boost::dynamic_bitset<>> test_vectors;
-    std::vector<boost::dynamic_bitset<>> exact_outputs;
+    std::vector<double> test_weights;
+    double total_weight;
+    bool unit_weights = true;
+    bool exhaustive = false;
+    OutputMatrix exact_outputs;
+    std::vector<size_t> vector_order;
+    Yosys::dict<Yosys::IdString, signature_t> signatures;
+    std::vector<double> input_probability;
+    std::vector<double> exact_probability;
+    double activity_estimate_baseline;
+    mutable double activity_baseline = -1.0;
+    std::vector<double> pair_weights;
+    double total_pair_weight = 0.0;
 
     // Parameters
     size_t test_vectors_n = 1000;
+    bool power_objective = false;
+    size_t batch_size = 0;
+    double sequential_z = 1.96;
+    bool screen = false;
 
     // Execution data
     unsigned processor_count;
@@ -116,12 +196,30 @@ private:
 
     static std::vector<boost::dynamic_bitset<>> simple_sample(unsigned long n, unsigned long log2max);
 
+    void distribution_sample(const distributions_t &distributions);
+
+    void compute_signatures();
+
+    bool signature_error(const solution_t &s, std::array<double, 2> &bounds) const;
+
+    void compute_probabilities();
+
+    std::array<double, 2> probability_estimate(const solution_t &s,
+                                               std::vector<double> *probabilities = nullptr) const;
+
+    double reliability_estimate(double r_s, size_t n_s) const;
+
+    size_t count_errors(const solution_t &s, size_t begin, size_t end) const;
+
     double circuit_reliability(const solution_t &s) const;
 
     double circuit_reliability_smt(const solution_t &s) const;
 
+    double switching_activity(const solution_t &s) const;
+
     boost::dynamic_bitset<> evaluate_graph(const solution_t &s,
-                                           const boost::dynamic_bitset<> &input) const;
+                                           const boost::dynamic_bitset<> &input,
+                                           std::map<vertex_d, bool> *cell_values = nullptr) const;
 
     size_t gates(const solution_t &s) const;
 };
@@ -36,11 +36,14 @@
 
 #include <boost/graph/topological_sort.hpp>
 
+#include <array>
 #include <random>
+#include <string>
 
 namespace yosys_als {
 
-extern std::default_random_engine rng;
+/// Random number generator, one for each thread, so that concurrent optimizers can be seeded
+extern thread_local std::default_random_engine rng;
 
 // Forward declaration
 template<typename E>
@@ -60,6 +63,20 @@ using archive_t = std::vector<archive_entry_t<E>>;
 /// Type for the input weights
 typedef Yosys::dict<Yosys::SigBit, double> weights_t;
 
+/**
+ * @brief Fidelity of the evaluation of the error of a solution
+ */
+struct fidelity_t {
+    /// Number of evaluated input vectors
+    size_t samples = 0;
+
+    /// If \c true, all the input vectors were evaluated and the error is exact
+    bool exhaustive = false;
+
+    /// Lower and upper 95% confidence bounds of the error
+    std::array<double, 2> bounds{{0.0, 0.0}};
+};
+
 /**
  * @brief Type for the optimizer context
  */
@@ -91,6 +108,12 @@ struct optimizer_parameters_t {
 
     /// Number of iterations
     size_t max_iter = 2500;
+
+    /// File backing the golden outputs of the evaluator, or empty to keep them in memory
+    std::string golden_path;
+
+    /// Hash of the circuit and of the options the golden outputs depend on
+    uint64_t golden_key = 0;
 };
 
 /**
@@ -138,20 +161,19 @@ public:
         archive_t<E> arch;
         for (size_t i = 0; i < soft_limit; i++) {
             // Do a "biased sweep" of the front to augment diversity of initial archive
+            bool partial;
             archive_entry_t<E> s =
-                    hill_climb(empty_solution(), static_cast<double>(i) / soft_limit);
-            if (std::find(arch.begin(), arch.end(), s) == arch.end())
-                arch.push_back(s);
+                    hill_climb(empty_solution(), static_cast<double>(i) / soft_limit, partial);
+            archive(arch, s, partial);
         }
 
-        erase_dominated(arch);
-
         double t = t_max;
         std::uniform_real_distribution<double> chance(0.0, 1.0);
         auto s_curr = arch[0]; // TODO Should we choose randomly and follow AMOSA?
 
         for (size_t i = 0; i < max_iter; i++) { // TODO Try a temperature scheduling approach
-            auto s_tick = neighbor_of(s_curr);
+            bool tick_partial;
+            auto s_tick = neighbor_of(s_curr, tick_partial);
 
             if (evaluator.dominates(s_curr, s_tick)) {
                 double delta_tot = evaluator.delta_dom(s_curr, s_tick);
@@ -178,9 +200,7 @@ public:
                         s_curr = std::move(s_tick);
                 } else {
                     s_curr = std::move(s_tick);
-                    if (std::find(arch.begin(), arch.end(), s_curr) == arch.end())
-                        arch.push_back(s_curr);
-                    erase_dominated(arch);
+                    archive(arch, s_curr, tick_partial);
                 }
             } else {
                 double delta_tot = 0.0;
@@ -197,9 +217,7 @@ public:
                         s_curr = std::move(s_tick);
                 } else {
                     s_curr = std::move(s_tick);
-                    if (std::find(arch.begin(), arch.end(), s_curr) == arch.end())
-                        arch.push_back(s_curr);
-                    erase_dominated(arch);
+                    archive(arch, s_curr, tick_partial);
                 }
             }
 
@@ -213,6 +231,59 @@ public:
         return arch;
     }
 
+    /**
+     * @brief Composes the fronts of the windows of the circuit in a front for the circuit
+     * As the errors of the windows add up at most, for each budget each window contributes the solution
+     * with the fewest gates within an equal share of the budget. Budgets are those that admit each
+     * solution of a window. Composed solutions are evaluated on the whole circuit, and the dominated
+     * ones are discarded.
+     * @param fronts The fronts of the windows
+     * @return The front of the composed solutions
+     */
+    archive_t<E> compose(const std::vector<archive_t<E>> &fronts) const {
+        std::vector<double> budgets;
+        for (auto &front : fronts) {
+            for (auto &entry : front)
+                budgets.push_back(entry.second[0] * fronts.size());
+        }
+        std::sort(budgets.begin(), budgets.end());
+        budgets.erase(std::unique(budgets.begin(), budgets.end()), budgets.end());
+
+        archive_t<E> arch;
+        for (auto budget : budgets) {
+            auto s = empty_solution().first;
+
+            for (auto &front : fronts) {
+                const archive_entry_t<E> *chosen = nullptr;
+                size_t chosen_gates = 0;
+                for (auto &entry : front) {
+                    if (entry.second[0] * fronts.size() <= budget &&
+                        (chosen == nullptr || gates(entry.first) < chosen_gates)) {
+                        chosen = &entry;
+                        chosen_gates = gates(entry.first);
+                    }
+                }
+
+                // LUTs of windows are matched by name to those of the circuit
+                if (chosen != nullptr) {
+                    for (auto &el : chosen->first)
+                        s.at(el.first) = el.second;
+                }
+            }
+
+            archive_entry_t<E> composed{s, evaluator.value(s)};
+            if (std::find(arch.begin(), arch.end(), composed) == arch.end())
+                arch.push_back(composed);
+        }
+
+        erase_dominated(arch);
+        std::sort(arch.begin(), arch.end(), [](const archive_entry_t<E> &a, const archive_entry_t<E> &b) {
+            return a.second[0] < b.second[0];
+        });
+
+        return arch;
+    }
+
     /**
      * @brief Returns an empty solution
      */
@@ -227,17 +298,36 @@ public:
         return {s, evaluator.empty_solution_value(s)};
     }
 
+    /**
+     * @brief Evaluates the fidelity of the error of a solution
+     * @param s A solution
+     */
+    fidelity_t fidelity(const solution_t &s) const {
+        return evaluator.fidelity(s);
+    }
+
+    /**
+     * @brief Estimates the switching power of a solution, relative to the exact circuit
+     * @param s A solution
+     */
+    double power(const solution_t &s) const {
+        return evaluator.power(s);
+    }
+
     /**
      * Converts a solution to a string
      * @param s A solution
-     * @return A string representation of the solution
+     * @return A string representation of the solution, i.e. the levels of the cells separated by dots
      */
     std::string to_string(const solution_t &s) const {
         std::string str;
 
         for (auto &v : vertices) {
-            if (g.g[v].type == vertex_t::CELL)
-                str += static_cast<char>(s.at(g.g[v])) + '0';
+            if (g.g[v].type == vertex_t::CELL) {
+                if (!str.empty())
+                    str += '.';
+                str += std::to_string(s.at(g.g[v]));
+            }
         }
 
         return str;
@@ -266,19 +356,23 @@ private:
     size_t max_iter = 2500;
 
     // Private methods
-    archive_entry_t<E> hill_climb(const archive_entry_t<E> &s, double arel_bias = 0.0) const {
+    archive_entry_t<E> hill_climb(const archive_entry_t<E> &s, double arel_bias, bool &partial) const {
         auto s_climb = s;
+        partial = false;
 
         for (size_t i = 0; i < max_iter / 10; i++) {
-            auto s_tick = neighbor_of(s_climb);
-            if (evaluator.dominates(s_tick, s_climb, arel_bias))
+            bool tick_partial;
+            auto s_tick = neighbor_of(s_climb, tick_partial);
+            if (evaluator.dominates(s_tick, s_climb, arel_bias)) {
                 s_climb = std::move(s_tick);
+                partial = tick_partial;
+            }
         }
 
         return s_climb;
     }
 
-    archive_entry_t<E> neighbor_of(const archive_entry_t<E> &s) const {
+    archive_entry_t<E> neighbor_of(const archive_entry_t<E> &s, bool &partial) const {
         solution_t s_tick;
         std::uniform_int_distribution<size_t> pos_dist(0, s.first.size() - 1);
         std::uniform_int_distribution<size_t> coin_flip(0, 1);
@@ -301,7 +395,27 @@ private:
             }
         }
 
-        return {s_tick, evaluator.value(s_tick)};
+        return {s_tick, evaluator.value(s_tick, s, partial)};
+    }
+
+    size_t gates(const solution_t &s) const {
+        size_t count = 0;
+
+        for (auto &el : s)
+            count += luts[get_lut_param(el.first.cell)][el.second].num_gates;
+
+        return count;
+    }
+
+    void archive(archive_t<E> &arch, archive_entry_t<E> &s, const bool partial) const {
+        // Partial values only decide comparisons, so solutions are evaluated in full when archived, and
+        // the archive never holds a value that could drop a member of the front
+        if (partial)
+            s.second = evaluator.value(s.first);
+
+        if (std::find(arch.begin(), arch.end(), s) == arch.end())
+            arch.push_back(s);
+        erase_dominated(arch);
     }
 
     void erase_dominated(archive_t<E> &arch) const {
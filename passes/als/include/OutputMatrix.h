@@ -0,0 +1,141 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Packed matrix of golden outputs for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_OUTPUTMATRIX_H
+#define YOSYS_ALS_OUTPUTMATRIX_H
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Packed, transposed matrix of the outputs of a circuit for a set of input vectors
+ * Each output is a row, holding its value for each vector, 64 vectors per word. The matrix is kept
+ * in memory, or in a memory-mapped file that can be reused by later runs on the same circuit.
+ * Reads are thread-safe, writes are not, as the columns of 64 vectors share their words.
+ */
+class OutputMatrix {
+public:
+    OutputMatrix() = default;
+
+    ~OutputMatrix();
+
+    OutputMatrix(const OutputMatrix &) = delete;
+
+    OutputMatrix &operator=(const OutputMatrix &) = delete;
+
+    /**
+     * @brief Allocates the matrix in memory, with all the bits cleared
+     * @param outputs The number of outputs
+     * @param vectors The number of input vectors
+     */
+    void allocate(size_t outputs, size_t vectors);
+
+    /**
+     * @brief Maps the matrix to a file
+     * A file committed with the same key and size is reused as it is. Otherwise the matrix is mapped to a
+     * temporary file with all the bits cleared, which replaces the file once committed, so that a file
+     * mapped by another run is never changed.
+     * @param path The path of the file
+     * @param outputs The number of outputs
+     * @param vectors The number of input vectors
+     * @param key A hash of the circuit and the vectors
+     * @return \c true if the file holds a committed matrix, otherwise \c false
+     */
+    bool map(const std::string &path, size_t outputs, size_t vectors, uint64_t key);
+
+    /**
+     * @brief Marks a mapped matrix as complete and moves it to its path, so that later runs can reuse it
+     */
+    void commit();
+
+    /**
+     * @brief Gets the number of outputs, i.e. of rows
+     */
+    size_t outputs() const;
+
+    /**
+     * @brief Gets the number of input vectors, i.e. of columns
+     */
+    size_t vectors() const;
+
+    /**
+     * @brief Sets the outputs for an input vector
+     * @param vector The index of the vector
+     * @param outputs The value of each output
+     */
+    void set_column(size_t vector, const boost::dynamic_bitset<> &outputs);
+
+    /**
+     * @brief Sets the outputs for 64 consecutive input vectors
+     * @param output The index of the output
+     * @param word The index of the word, i.e. of the vectors divided by 64
+     * @param value The value of the output, the first vector being the least significant bit
+     */
+    void set_word(size_t output, size_t word, uint64_t value);
+
+    /**
+     * @brief Gets the outputs for an input vector
+     * @param vector The index of the vector
+     * @return The value of each output
+     */
+    boost::dynamic_bitset<> column(size_t vector) const;
+
+    /**
+     * @brief Checks the outputs for an input vector
+     * @param vector The index of the vector
+     * @param outputs The value of each output
+     * @return \c true if the outputs are those of the matrix, otherwise \c false
+     */
+    bool matches(size_t vector, const boost::dynamic_bitset<> &outputs) const;
+
+    /**
+     * @brief Gets a row of the matrix
+     * @param output The index of the output
+     * @return The words of the row, the first vector being the least significant bit of the first word
+     */
+    const uint64_t *row(size_t output) const;
+
+private:
+    struct header_t;
+
+    void release();
+
+    std::vector<uint64_t> memory;
+    std::string target_path;
+    std::string tmp_path;
+    void *data = nullptr;
+    size_t data_size = 0;
+    uint64_t *words = nullptr;
+    size_t n_outputs = 0;
+    size_t n_vectors = 0;
+    size_t row_words = 0;
+};
+}
+
+#endif //YOSYS_ALS_OUTPUTMATRIX_H
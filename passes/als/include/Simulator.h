@@ -0,0 +1,103 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Bit-parallel simulation of gate-level modules for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_SIMULATOR_H
+#define YOSYS_ALS_SIMULATOR_H
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace yosys_als {
+
+/// Type for a bit of a port, i.e. its name and offset
+typedef std::pair<Yosys::IdString, int> port_bit_t;
+
+/**
+ * @brief Bit-parallel simulator of a combinational gate-level module
+ * The module is compiled once to a list of operations in topological order. Each simulation evaluates
+ * 64 input vectors at once, one for each bit of a word. The supported cells are \c $_BUF_, \c $_NOT_,
+ * \c $_AND_, \c $_OR_, \c $_XOR_ and \c $lut. Undriven signals are zero.
+ */
+class Simulator {
+public:
+    /**
+     * @brief Compiles a module
+     * Throws \c std::runtime_error if the module holds unsupported cells or combinational loops.
+     * @param module A module
+     */
+    explicit Simulator(Yosys::Module *module);
+
+    /**
+     * @brief Gets the input bits, in the order of the ports
+     * @return The input bits
+     */
+    const std::vector<port_bit_t> &inputs() const;
+
+    /**
+     * @brief Gets the output bits, in the order of the ports
+     * @return The output bits
+     */
+    const std::vector<port_bit_t> &outputs() const;
+
+    /**
+     * @brief Simulates 64 input vectors
+     * This method can be called concurrently.
+     * @param input_words A word for each input bit, whose bit \c i belongs to vector \c i
+     * @return A word for each output bit, whose bit \c i belongs to vector \c i
+     */
+    std::vector<uint64_t> simulate(const std::vector<uint64_t> &input_words) const;
+
+private:
+    /// An operation, i.e. a cell evaluated on the words of its nodes
+    struct op_t {
+        enum {
+            BUF, NOT, AND, OR, XOR, LUT
+        } type;
+        std::vector<size_t> in;
+        size_t out;
+        std::vector<bool> table;
+    };
+
+    std::vector<port_bit_t> input_bits;
+    std::vector<port_bit_t> output_bits;
+    std::vector<size_t> input_nodes;
+    std::vector<size_t> output_nodes;
+    std::vector<op_t> ops;
+    size_t num_nodes = 0;
+};
+}
+
+#endif //YOSYS_ALS_SIMULATOR_H
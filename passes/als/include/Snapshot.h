@@ -0,0 +1,95 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Immutable snapshot of the catalogue for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_SNAPSHOT_H
+#define YOSYS_ALS_SNAPSHOT_H
+
+#include "smtsynth.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Read-only, memory-mapped snapshot of the catalogue
+ * The snapshot is a sorted array of fixed-size records, looked up by binary search without any
+ * parsing or locking. Concurrent processes mapping the same file share it through the page cache.
+ * Only entries with at most 6 inputs and \c max_gates gates can be stored.
+ */
+class Snapshot {
+public:
+    /// Maximum number of gates of a stored model
+    static constexpr size_t max_gates = 24;
+
+    /**
+     * @brief Maps a snapshot file
+     * Snapshots written with a different SMT encoding version are rejected as invalid.
+     * @param path The path of the snapshot file
+     */
+    explicit Snapshot(const std::string &path);
+
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    /**
+     * @brief Looks up an entry
+     * @param key The key of the entry
+     * @param aig Set to the stored model on a hit
+     * @return \c true on a hit, otherwise \c false
+     */
+    bool lookup(const std::string &key, aig_model_t &aig) const;
+
+    /**
+     * @brief Gets the number of records in the snapshot
+     * @return The number of records
+     */
+    size_t size() const;
+
+    /**
+     * @brief Writes a snapshot file
+     * The file is replaced atomically, so processes mapping the previous version are not affected.
+     * @param path The path of the snapshot file
+     * @param entries The entries, as key and model pairs, synthesized with the current SMT encoding
+     * @return The number of stored entries
+     */
+    static size_t write(const std::string &path, const std::vector<std::pair<std::string, aig_model_t>> &entries);
+
+private:
+    struct header_t;
+    struct record_t;
+
+    void *data = nullptr;
+    size_t data_size = 0;
+    const record_t *records = nullptr;
+    size_t count = 0;
+};
+}
+
+#endif //YOSYS_ALS_SNAPSHOT_H
@@ -0,0 +1,122 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Bit-sliced arithmetic on packed simulation words for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_BITSLICE_H
+#define YOSYS_ALS_BITSLICE_H
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Type for 64 bit-sliced unsigned numbers
+ * Word \c i holds bit \c i of each number, number \c l being in bit \c l of the words. Numbers of any
+ * width are handled, as the arithmetic ripples over the words.
+ */
+typedef std::vector<uint64_t> sliced_t;
+
+/**
+ * @brief Reductions of bit-sliced numbers over many words
+ */
+struct sliced_stats_t {
+    /// Maximum, as a bit-sliced number with a single lane
+    std::vector<bool> max;
+
+    /// Sum of the numbers
+    double sum = 0.0;
+
+    /// Count of the numbers, by the position of their most significant bit plus one (0 for zero)
+    std::vector<size_t> histogram;
+
+    /**
+     * @brief Constructor
+     * @param width The width of the reduced numbers
+     */
+    explicit sliced_stats_t(size_t width = 0);
+
+    /**
+     * @brief Adds the lanes of some numbers to the reductions
+     * @param x The numbers
+     * @param mask The lanes to be reduced
+     */
+    void add(const sliced_t &x, uint64_t mask);
+
+    /**
+     * @brief Gets the maximum as a floating-point value
+     * @return The maximum
+     */
+    double max_value() const;
+};
+
+/**
+ * @brief Computes the absolute difference of bit-sliced numbers
+ * The difference is computed by a ripple-borrow subtractor, and the negative lanes are negated.
+ * @param a Some numbers
+ * @param b Other numbers, as wide as \c a
+ * @return The absolute differences, as wide as the operands
+ */
+sliced_t sliced_abs_difference(const sliced_t &a, const sliced_t &b);
+
+/**
+ * @brief Evaluates a LUT on 64 input vectors
+ * The LUT is the sum of the minterms of its specification.
+ * @param fun_spec The specification of the LUT
+ * @param in_words A word for each input of the LUT, from the least significant one
+ * @return The word of the output of the LUT
+ */
+uint64_t sliced_lut(const boost::dynamic_bitset<> &fun_spec, const std::vector<uint64_t> &in_words);
+
+/**
+ * @brief Computes a word of an input for exhaustive simulation
+ * Vector \c l of block \c b is the one numbered <tt>64 * b + l</tt>, input \c i being bit \c i of
+ * the number.
+ * @param input The index of the input
+ * @param block The index of the block of 64 vectors
+ * @return The word of the input
+ */
+uint64_t exhaustive_word(size_t input, uint64_t block);
+
+/**
+ * @brief Finds the lanes that hold the maximum of bit-sliced numbers
+ * The lanes are compared from the most significant bit, keeping the candidates with the bit set.
+ * @param x The numbers
+ * @param mask The lanes to be compared
+ * @return The mask of the lanes that hold the maximum
+ */
+uint64_t sliced_max_lanes(const sliced_t &x, uint64_t mask);
+
+/**
+ * @brief Finds the toggles of a signal over a sequence of vectors packed in words
+ * @param words The words of the signal, vector \c l being bit <tt>l % 64</tt> of word <tt>l / 64</tt>
+ * @param n The number of vectors
+ * @return The words of the toggles, bit \c l being set if vector \c l differs from the one before it
+ */
+std::vector<uint64_t> sliced_toggles(const std::vector<uint64_t> &words, size_t n);
+}
+
+#endif //YOSYS_ALS_BITSLICE_H
@@ -0,0 +1,85 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Input distributions for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_DISTRIBUTION_H
+#define YOSYS_ALS_DISTRIBUTION_H
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Distribution of the values of an input signal
+ * Either the bits of the signal are independent, each one with the same probability of being one,
+ * or the values of the whole signal follow a histogram.
+ */
+struct signal_distribution_t {
+    /// The input signal
+    Yosys::SigSpec signal;
+
+    /// Probability of each bit of the signal being one, if there is no histogram
+    double probability = 0.5;
+
+    /// Values of the signal with their weights, not necessarily normalized
+    std::vector<std::pair<uint64_t, double>> histogram;
+
+    /**
+     * @brief Converts the distribution to a string
+     * @return A line of text naming the signal and describing the distribution
+     */
+    std::string to_string() const;
+};
+
+/// Type for the distributions of the inputs of a module, inputs without one are uniform
+typedef std::vector<signal_distribution_t> distributions_t;
+
+/**
+ * @brief Reads a histogram of values of a signal
+ * Each line holds a value, either decimal or with the \c 0x or \c 0b prefix, and optionally its
+ * weight, which is 1 otherwise. So a trace of sampled values is a histogram too. Empty lines and
+ * lines starting with \c # are skipped.
+ * @param is The stream to read from
+ * @param width The width of the signal, at most 64 bits
+ * @param histogram Set to the values with their weights
+ * @return \c true if the histogram is valid and has a positive weight, otherwise \c false
+ */
+bool read_histogram(std::istream &is, int width, std::vector<std::pair<uint64_t, double>> &histogram);
+}
+
+#endif //YOSYS_ALS_DISTRIBUTION_H
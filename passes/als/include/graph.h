@@ -48,9 +48,13 @@ struct vertex_t {
     } type;
     Yosys::IdString name;
     Yosys::Cell *cell;
+    Yosys::SigBit bit;
 
     boost::optional<size_t> weight = boost::none;
 
+    /// If \c true, the cell drives an output port of the module, or no other cell
+    bool output = false;
+
     unsigned int hash() const {
         return name.hash();
     }
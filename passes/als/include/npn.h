@@ -0,0 +1,88 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief NPN classification of Boolean functions for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_NPN_H
+#define YOSYS_ALS_NPN_H
+
+#include "smtsynth.h"
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief An NPN transformation
+ * The transformed function \c g is defined as <tt>g(x) = f(y) ^ out_neg</tt>, where
+ * <tt>y[i] = x[perm[i]] ^ neg[i]</tt>.
+ */
+struct npn_transform_t {
+    /// Input permutation
+    std::vector<size_t> perm;
+
+    /// Input negations
+    std::vector<bool> neg;
+
+    /// Output negation
+    bool out_neg = false;
+};
+
+/**
+ * @brief An NPN equivalence class
+ */
+struct npn_class_t {
+    /// The representative of the class
+    boost::dynamic_bitset<> representative;
+
+    /// A transformation for each member of the class (including the representative)
+    std::vector<npn_transform_t> members;
+};
+
+/**
+ * @brief Enumerates the NPN classes of all functions with given arity
+ * @param arity The number of inputs (at most 4)
+ * @return The NPN classes
+ */
+std::vector<npn_class_t> npn_classes(unsigned int arity);
+
+/**
+ * @brief Applies an NPN transformation to a function
+ * @param fun_spec A function specification
+ * @param t A transformation
+ * @return The transformed function specification
+ */
+boost::dynamic_bitset<> npn_apply(const boost::dynamic_bitset<> &fun_spec, const npn_transform_t &t);
+
+/**
+ * @brief Applies an NPN transformation to an AIG model
+ * Inverters are free in the model, so the result has the same number of gates.
+ * @param aig An AIG model
+ * @param t A transformation
+ * @return The transformed AIG model
+ */
+aig_model_t npn_apply(const aig_model_t &aig, const npn_transform_t &t);
+}
+
+#endif //YOSYS_ALS_NPN_H
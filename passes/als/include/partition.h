@@ -0,0 +1,69 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Partitioning of modules in windows for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_PARTITION_H
+#define YOSYS_ALS_PARTITION_H
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief Partitions the LUTs of a module in windows, by levelized min-cut
+ * Windows are bands of consecutive logic levels. Each band holds at most \c window_size LUTs, and ends
+ * at the level crossed by the fewest signals among those where it is at least half full. Levels with
+ * more than \c window_size LUTs are split, as LUTs on the same level are independent.
+ * @param module A module mapped to LUTs
+ * @param window_size The maximum number of LUTs in a window
+ * @return The names of the LUTs of each window, in topological order of the windows
+ */
+std::vector<std::vector<Yosys::IdString>> partition_module(Yosys::Module *module, size_t window_size);
+
+/**
+ * @brief Extracts a window of a module to a module of its own
+ * Signals crossing the cut of the window become wires of one bit, which are input ports if they are
+ * driven outside of the window, and output ports if they are used outside of it, even when LUTs of the
+ * window also read them. LUTs keep their names, so that solutions for the window apply to the module.
+ * @param design The design to add the window to
+ * @param name The name of the window
+ * @param module The module
+ * @param cells The names of the LUTs of the window
+ * @return The window
+ */
+Yosys::Module *extract_window(Yosys::Design *design, Yosys::IdString name, Yosys::Module *module,
+                              const std::vector<Yosys::IdString> &cells);
+}
+
+#endif //YOSYS_ALS_PARTITION_H
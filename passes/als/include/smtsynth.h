@@ -63,8 +63,18 @@ struct aig_model_t {
 
     /// Is valid?
     bool is_valid = false;
+
+    /// Is the number of gates proven minimal?
+    bool is_optimal = false;
 };
 
+/**
+ * @brief Version of the SMT encoding
+ * Increase it whenever a change to the encoding may produce different models, so that the models
+ * stored in the catalogue by previous versions are not used anymore.
+ */
+constexpr unsigned int smt_encoding_version = 1;
+
 /**
  * @brief SMT AIG exact synthesis for given function specification
  * @param fun_spec The function specification
@@ -72,6 +82,13 @@ struct aig_model_t {
  * @return The synthesized AIG model
  */
 aig_model_t synthesize_lut(const boost::dynamic_bitset<> &fun_spec, unsigned int out_distance, unsigned int max_tries);
+
+/**
+ * @brief Simulates an AIG model on all the rows of its truth table
+ * @param aig An AIG model
+ * @return The function implemented by the model
+ */
+boost::dynamic_bitset<> simulate_aig(const aig_model_t &aig);
 } // namespace yosys_als
 
 #endif //YOSYS_ALS_SMTSYNTH_H
@@ -0,0 +1,157 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Sets of circuit variants for Yosys ALS module
+ */
+
+#ifndef YOSYS_ALS_VARIANTS_H
+#define YOSYS_ALS_VARIANTS_H
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace yosys_als {
+
+/**
+ * @brief A variant of the circuit in the archive of results
+ * A variant is stored as a difference from the exact circuit, i.e. the LUTs it changes.
+ */
+struct variant_t {
+    /// Chosen approximation level for each LUT, by cell name
+    Yosys::dict<Yosys::IdString, size_t> levels;
+
+    /// Specification of each LUT at the chosen level, by cell name
+    Yosys::dict<Yosys::IdString, Yosys::Const> luts;
+
+    /// Values of the objectives, i.e. error and ratio of gates to the exact circuit
+    std::array<double, 2> value;
+
+    /// Ratio of the switching power estimate to the exact circuit
+    double power = 1.0;
+
+    /// Number of gates of the LUTs at the chosen levels
+    size_t gates = 0;
+
+    /// Number of input vectors evaluated for the error
+    size_t samples = 0;
+
+    /// If \c true, all the input vectors were evaluated
+    bool exhaustive = false;
+
+    /// Lower and upper 95% confidence bounds of the error
+    std::array<double, 2> error_bounds{{0.0, 0.0}};
+
+    /// If \c true, the variant was mapped to 6-input LUTs for an estimate of its size
+    bool estimated = false;
+
+    /// Number of 6-input LUTs of the estimate
+    size_t lut6_count = 0;
+
+    /// Depth in 6-input LUTs of the estimate
+    size_t lut6_depth = 0;
+};
+
+/**
+ * @brief Writes a set of variants
+ * The set is a text file that holds the number of variants, then, for each variant, the number of
+ * LUTs, the values of the objectives, the gates, the fidelity of the error and the power, followed by
+ * the cell name, level and specification of each LUT. Size estimates are not stored, as they are cheap
+ * to compute again.
+ * @param os An output stream
+ * @param variants The variants
+ */
+void write_variant_set(std::ostream &os, const std::vector<variant_t> &variants);
+
+/**
+ * @brief Reads a set of variants
+ * @param is An input stream
+ * @param variants Set to the variants
+ * @return \c false if the set is malformed, otherwise \c true
+ */
+bool read_variant_set(std::istream &is, std::vector<variant_t> &variants);
+
+/**
+ * @brief Computes the confidence bounds of an error rate measured on samples, 95% unless told otherwise
+ * The bounds are those of the Wilson score interval, which stays within [0, 1] also when few errors are
+ * sampled.
+ * @param errors The number of erroneous samples
+ * @param samples The number of samples
+ * @param z The two-sided quantile of the standard normal distribution for the confidence
+ * @return The lower and upper bounds
+ */
+std::array<double, 2> wilson_bounds(size_t errors, size_t samples, double z = 1.96);
+
+/**
+ * @brief Computes the two-sided quantile of the standard normal distribution for a significance level
+ * @param alpha The probability of a deviation larger than the quantile, either way
+ * @return The quantile z, such that P(|Z| > z) = alpha
+ */
+double normal_quantile(double alpha);
+
+/**
+ * @brief Gets the name of the files of a variant written by als_apply -all, without extension
+ * @param entry The entry of the variant in the archive
+ */
+std::string variant_file_name(size_t entry);
+
+/**
+ * @brief Writes the archive of variants as JSON
+ * Each record holds the entry, file name, objectives, gates, fidelity of the error, power, the 6-input LUT
+ * estimate, if any, and the level and specification of each LUT.
+ * @param os An output stream
+ * @param module_name The name of the module
+ * @param metric The error metric
+ * @param variants The variants
+ */
+void write_archive_json(std::ostream &os, const std::string &module_name, const std::string &metric,
+                        const std::vector<variant_t> &variants);
+
+/**
+ * @brief Writes the archive of variants as CSV
+ * Each row holds the same fields as the JSON records, with a column for the level of each LUT.
+ * @param os An output stream
+ * @param variants The variants
+ */
+void write_archive_csv(std::ostream &os, const std::vector<variant_t> &variants);
+
+/**
+ * @brief Applies a variant to the exact circuit, by setting the specification of its LUTs
+ * @param module The module of the exact circuit
+ * @param variant A variant
+ * @return The number of LUTs of the variant that are missing from the module or have a different width
+ */
+size_t apply_variant(Yosys::Module *module, const variant_t &variant);
+}
+
+#endif //YOSYS_ALS_VARIANTS_H
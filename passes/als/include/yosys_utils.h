@@ -25,6 +25,7 @@
 #ifndef YOSYS_ALS_YOSYS_UTILS_H
 #define YOSYS_ALS_YOSYS_UTILS_H
 
+#include "Catalogue.h"
 #include "smtsynth.h"
 
 #if defined __GNUC__
@@ -38,10 +39,16 @@
 #pragma GCC diagnostic pop
 #endif
 
-#include <sqlite3.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace yosys_als {
 
+/// Serializes logging from synthesis threads
+extern std::mutex log_mtx;
+
 /// Type for the catalogue of synthesized LUTs
 typedef Yosys::dict<Yosys::Const, std::vector<aig_model_t>> lut_catalogue_t;
 
@@ -49,9 +56,27 @@ typedef Yosys::dict<Yosys::Const, std::vector<aig_model_t>> lut_catalogue_t;
  * @brief Wrapper for \c synthesize_lut
  * @param lut The LUT specification
  * @param out_distance The approximation degree
+ * @param catalogue The catalogue used as a cache, or \c nullptr
  * @return The synthesized AIG model
  */
-aig_model_t synthesize_lut(const Yosys::Const &lut, unsigned int out_distance, unsigned int max_tries, bool debug, sqlite3 *db);
+aig_model_t synthesize_lut(const Yosys::Const &lut, unsigned int out_distance, unsigned int max_tries, bool debug,
+                           Catalogue *catalogue);
+
+/**
+ * @brief Runs tasks in processes forked from the design, at most \c worker_count at a time
+ * Yosys global state is not thread-safe, so each task changes its copy-on-write image and reports through
+ * a pipe. The logs of the workers are discarded, and exceptions thrown by a task are caught in its worker.
+ * Failed tasks are reported on the main process once all the others have finished, by \c log_error or, if
+ * they are not fatal, by \c log_warning.
+ * @param names The names of the tasks, for error messages
+ * @param task The task, which returns its result or throws
+ * @param done The procedure that receives the result of each task that succeeds
+ * @param worker_count The maximum number of workers, or 0 for one for each core
+ * @param fatal If \c false, failed tasks are only warned about
+ */
+void run_forked(const std::vector<std::string> &names, const std::function<std::string(size_t)> &task,
+                const std::function<void(size_t, const std::string &)> &done, unsigned int worker_count = 0,
+                bool fatal = true);
 
 /**
  * Checks if cell is a LUT
@@ -0,0 +1,131 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Rewriting of LUTs as AIGs for Yosys ALS module
+ */
+
+#include "AigRewriter.h"
+
+#include <vector>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/*
+ * Exposed methods
+ */
+
+AigRewriter::AigRewriter(Module *module) : module(module), sigmap(module) {}
+
+void AigRewriter::replace(Cell *lut, const aig_model_t &aig) {
+    // Literals of the variables in the model, starting from constant zero and the LUT inputs
+    std::vector<lit_t> lits{literal(State::S0)};
+    SigSpec lut_out;
+    for (auto &conn : lut->connections()) {
+        if (lut->input(conn.first)) {
+            for (auto &bit : conn.second)
+                lits.push_back(literal(bit));
+        } else if (lut->output(conn.first)) {
+            lut_out = conn.second;
+        }
+    }
+
+    auto edge = [&lits](size_t var, bool p) {
+        auto lit = lits[var];
+        lit.second = lit.second != !p;
+        return lit;
+    };
+
+    for (size_t i = aig.num_inputs; i < aig.num_inputs + aig.num_gates; i++)
+        lits.push_back(make_and(edge(aig.s[i][0], aig.p[i][0]), edge(aig.s[i][1], aig.p[i][1])));
+
+    auto out = signal(edge(aig.out, aig.out_p));
+    module->connect(lut_out, out);
+    module->remove(lut);
+
+    // Readers of the LUT output now share the gates that drive it
+    sigmap.add(lut_out, out);
+}
+
+size_t AigRewriter::gates() const {
+    return and_gates.size() + inverters.size();
+}
+
+/*
+ * Private methods
+ */
+
+AigRewriter::lit_t AigRewriter::literal(const SigBit &bit) const {
+    auto mapped = sigmap(bit);
+    if (mapped == SigBit(State::S1))
+        return {SigBit(State::S0), true};
+
+    return {mapped, false};
+}
+
+AigRewriter::lit_t AigRewriter::make_and(lit_t a, lit_t b) {
+    const lit_t zero{SigBit(State::S0), false};
+    const lit_t one{SigBit(State::S0), true};
+
+    // Constant propagation and trivial cases
+    if (a == zero || b == zero)
+        return zero;
+    if (a == one)
+        return b;
+    if (b == one || a == b)
+        return a;
+    if (a.first == b.first)
+        return zero;
+
+    // Fan-ins are ordered, so that both orders hash to the same gate
+    if (b.first < a.first || (b.first == a.first && b.second < a.second))
+        std::swap(a, b);
+
+    auto key = std::make_pair(a, b);
+    auto gate = and_gates.find(key);
+    if (gate != and_gates.end())
+        return {gate->second, false};
+
+    Wire *and_y = module->addWire(NEW_ID);
+    module->addAndGate(NEW_ID, signal(a), signal(b), and_y);
+    and_gates[key] = and_y;
+
+    return {and_y, false};
+}
+
+SigBit AigRewriter::signal(const lit_t &lit) {
+    if (!lit.second)
+        return lit.first;
+    if (lit.first == SigBit(State::S0))
+        return State::S1;
+
+    auto inverter = inverters.find(lit.first);
+    if (inverter != inverters.end())
+        return inverter->second;
+
+    Wire *not_y = module->addWire(NEW_ID);
+    module->addNotGate(NEW_ID, lit.first, not_y);
+    inverters[lit.first] = not_y;
+
+    return not_y;
+}
+}
@@ -24,86 +24,400 @@
 
 #include "AlsWorker.h"
 
+#include "AigRewriter.h"
 #include "ErSEvaluator.h"
 #include "EpsMaxEvaluator.h"
+#include "partition.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "backends/ilang/ilang_backend.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
 
 #include <boost/filesystem.hpp>
 
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
 
+#include <unistd.h>
+
 USING_YOSYS_NAMESPACE
 
 namespace yosys_als {
+
+/*
+ * Utility functions and procedures
+ */
+
+/**
+ * @brief Dumps a module in RTLIL format
+ */
+static std::string dump_module(Module *const module) {
+    std::ostringstream os;
+    ILANG_BACKEND::dump_module(os, "", module, module->design, false);
+    return os.str();
+}
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a string
+ */
+static uint64_t fnv1a(const std::string &s) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto c : s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Reads a whole file
+ * @return \c false if the file cannot be read, otherwise \c true
+ */
+static bool read_file(const std::string &path, std::string &content) {
+    std::ifstream f(path);
+    if (!f)
+        return false;
+
+    std::ostringstream os;
+    os << f.rdbuf();
+    content = os.str();
+    return true;
+}
+
+/**
+ * @brief Computes the depth in LUTs of a module mapped to LUTs
+ */
+static size_t lut_depth(Module *const module) {
+    SigMap sigmap(module);
+    dict<SigBit, Cell *> drivers;
+    for (auto cell : module->cells()) {
+        if (cell->type == "$lut") {
+            for (auto bit : sigmap(cell->getPort("\\Y")))
+                drivers[bit] = cell;
+        }
+    }
+
+    // Other cells, e.g. flip-flops, start paths like inputs do
+    dict<Cell *, size_t> depths;
+    std::function<size_t(Cell *)> depth_of = [&](Cell *cell) -> size_t {
+        auto it = depths.find(cell);
+        if (it != depths.end())
+            return it->second;
+
+        size_t depth = 0;
+        for (auto bit : sigmap(cell->getPort("\\A"))) {
+            auto driver = drivers.find(bit);
+            if (driver != drivers.end())
+                depth = std::max(depth, depth_of(driver->second));
+        }
+        return depths[cell] = depth + 1;
+    };
+
+    size_t max_depth = 0;
+    for (auto &driver : drivers)
+        max_depth = std::max(max_depth, depth_of(driver.second));
+
+    return max_depth;
+}
+
 /**
- * Runs an ALS step on selected module
- * @param module A module
+ * @brief Writes a front of solutions, as the value and the levels of the LUTs of each entry
  */
-void AlsWorker::run(Module *const module) {
-    // -1. Ensure our cache db is ready
-    sqlite3_open("catalogue.db", &db);
+template<typename E>
+static std::string write_front(const archive_t<E> &front) {
+    std::ostringstream os;
+    os << std::setprecision(std::numeric_limits<double>::max_digits10) << front.size() << "\n";
+    for (auto &entry : front) {
+        os << entry.first.size();
+        for (auto v : entry.second)
+            os << " " << v;
+        os << "\n";
+        for (auto &el : entry.first)
+            os << el.first.name.str() << " " << el.second << "\n";
+    }
+    return os.str();
+}
+
+/**
+ * @brief Reads a front of solutions written by write_front, matching the LUTs by name to the cells of a window
+ */
+template<typename E>
+static archive_t<E> read_front(Module *const window, const std::string &s) {
+    auto error = std::runtime_error(std::string("Cannot read the front of window ") + log_id(window));
+    std::istringstream is(s);
+    size_t front_size;
+    if (!(is >> front_size))
+        throw error;
+
+    archive_t<E> front(front_size);
+    for (auto &entry : front) {
+        size_t solution_size;
+        if (!(is >> solution_size))
+            throw error;
+        for (auto &v : entry.second) {
+            if (!(is >> v))
+                throw error;
+        }
+
+        for (size_t i = 0; i < solution_size; i++) {
+            std::string name;
+            size_t level;
+            if (!(is >> name >> level))
+                throw error;
+
+            vertex_t v;
+            v.type = vertex_t::CELL;
+            v.name = name;
+            v.cell = window->cell(v.name);
+            if (v.cell == nullptr)
+                throw error;
+            entry.first[v] = level;
+        }
+    }
+
+    return front;
+}
+
+/*
+ * Exposed methods
+ */
+
+/**
+ * Runs an ALS step on selected modules
+ * @param modules The modules
+ */
+void AlsWorker::run(const std::vector<Module *> &modules) {
+    // -1. Ensure our cache db is ready, synthesis threads must not wait for its writes
+    open_catalogue();
 
     // 0. Is this a rewrite run?
     if (rewrite_run) {
-        log_header(module->design, "Rewriting the AIG.\n");
-        Pass::call(module->design, "clean");
+        for (auto module : modules)
+            rewrite_luts(module);
 
-        std::vector<Cell *> to_sub;
-        for (auto cell : module->cells()) {
-            if (is_lut(cell)) {
-                to_sub.push_back(cell);
+        close_catalogue();
+        return;
+    }
+
+    // 0. Were these results already computed on the same modules with the same options?
+    std::vector<job_t> jobs(modules.size());
+    std::vector<Module *> mapped_modules;
+    for (size_t i = 0; i < modules.size(); i++) {
+        auto &job = jobs[i];
+        job.key = result_key(modules[i]);
+        char hash_s[17];
+        snprintf(hash_s, sizeof(hash_s), "%016llx", static_cast<unsigned long long>(fnv1a(job.key)));
+        job.cache_dir = result_cache_path + "/" + (modules[i]->name.c_str() + 1) + "-" + hash_s;
+
+        job.module = rerun ? nullptr : restore_results(modules[i], job.cache_dir, job.key, job.variants,
+                                                       job.log_string);
+        if (job.module != nullptr) {
+            // Restoring switches to the slice of the catalogue stored with the results
+            job.restored = true;
+            close_catalogue();
+            open_catalogue();
+            continue;
+        }
+
+        // 1. 4-LUT synthesis
+        job.module = modules[i];
+        Pass::call_on_module(job.module->design, job.module, "synth -lut 4");
+        job.mapped = dump_module(job.module);
+        mapped_modules.push_back(job.module);
+
+        // The golden outputs are mapped in the directory of results
+        if (map_golden)
+            boost::filesystem::create_directory(std::string("als_") + (job.module->name.c_str() + 1));
+
+        // 1a. Partitioning of very large modules, whose windows are optimized on their own
+        if (window_size > 0)
+            partition(job);
+    }
+
+    // 2. SMT exact synthesis, at once for all the modules, so that shared LUTs are synthesized once
+    if (!mapped_modules.empty()) {
+        log_header(mapped_modules.front()->design, "Running SMT exact synthesis for LUTs.\n");
+        exact_synthesis_helper(mapped_modules);
+    }
+
+    // 3. Optimize, with a process for each window, then for each module, at a time on each core
+    if (!mapped_modules.empty()) {
+        log_header(mapped_modules.front()->design, "Running approximation heuristic.\n");
+
+        // Each optimizer only holds its window, so memory is bounded by the window size
+        std::vector<std::pair<size_t, size_t>> tasks;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].restored)
+                continue;
+            jobs[i].fronts.resize(jobs[i].windows.size());
+            for (size_t w = 0; w < jobs[i].windows.size(); w++) {
+                tasks.emplace_back(i, w);
+                names.push_back(log_id(jobs[i].windows[w]));
             }
         }
 
-        for (auto cell : to_sub) {
-            // We get without doubts here - if we used it in a solution, we MUST have its synth
-            replace_lut(module, cell, synthesize_lut(get_lut_param(cell), 0, max_tries, debug, db));
+        run_forked(names, [&](size_t t) { return optimize_job(jobs[tasks[t].first], tasks[t].second); },
+                   [&](size_t t, const std::string &front) { jobs[tasks[t].first].fronts[tasks[t].second] = front; });
+
+        tasks.clear();
+        names.clear();
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (!jobs[i].restored) {
+                tasks.emplace_back(i, jobs[i].windows.size());
+                names.push_back(log_id(jobs[i].module));
+            }
         }
 
-        Pass::call(module->design, "clean");
+        run_forked(names, [&](size_t t) { return optimize_job(jobs[tasks[t].first], tasks[t].second); },
+                   [&](size_t t, const std::string &result) {
+                       // The log string comes first, with its length, then the variants
+                       auto &job = jobs[tasks[t].first];
+                       std::istringstream is(result);
+                       size_t length;
+                       if (!(is >> length) || is.get() != '\n')
+                           log_error("Cannot read the results of module %s.\n", log_id(job.module));
+                       job.log_string.resize(length);
+                       if (!is.read(&job.log_string[0], length) || !read_variant_set(is, job.variants))
+                           log_error("Cannot read the results of module %s.\n", log_id(job.module));
+                   });
+    }
+
+    for (auto &job : jobs) {
+        if (!job.restored)
+            save_results(job.module, job.cache_dir, job.key, job.mapped, job.variants, job.log_string);
+
+        // 4. Rewrite
+        if (estimate)
+            estimate_luts(job.module, job.variants);
+        write_variants(job.module, job.variants, job.log_string);
+
+        log_pop();
+
+        // 5. Output results
+        log_header(job.module->design, "Showing archive of results for module %s.\n", log_id(job.module));
+        log("%s", job.log_string.c_str());
+    }
+
+    // +1. Close our db cache
+    close_catalogue();
+}
+
+void AlsWorker::partition(job_t &job) const {
+    auto windows = partition_module(job.module, window_size);
+    if (windows.size() < 2)
         return;
+
+    // Windows are kept out of the design, they only live for the optimization
+    job.window_design.reset(new Design);
+    for (size_t w = 0; w < windows.size(); w++) {
+        auto name = stringf("\\%s_window%zu", log_id(job.module), w);
+        job.windows.push_back(extract_window(job.window_design.get(), name, job.module, windows[w]));
     }
+    log("Partitioned module %s in %zu windows of at most %zu LUTs.\n", log_id(job.module), windows.size(),
+        window_size);
+}
 
-    // 1. 4-LUT synthesis
-    ScriptPass::call(module->design, "synth -lut 4");
+std::string AlsWorker::optimize_job(const job_t &job, const size_t window) {
+    // Each module, or window, is optimized as if it were alone, whatever the process; an index past the
+    // windows stands for the module
+    rng.seed(seed ? *seed + (window < job.windows.size() ? window : 0) : std::random_device{}());
 
-    // 2. SMT exact synthesis
-    log_header(module->design, "Running SMT exact synthesis for LUTs.\n");
-    exact_synthesis_helper(module);
+    // Each metric has its own golden outputs
+    std::string golden_path;
+    if (map_golden)
+        golden_path = "als_" + std::string(job.module->name.c_str() + 1) + "/golden_" + metric + ".bin";
 
-    // 3. + 4. Optimize and rewrite
     // TODO Make this more elegant
-    string log_string;
     if (metric == "epsmax") {
         EpsMaxEvaluator::parameters_t parameters;
         parameters.max_iter = max_iter;
-        log_string = optimizeAndRewrite<EpsMaxEvaluator>(module, parameters);
+        parameters.golden_path = golden_path;
+        parameters.golden_key = fnv1a(job.key);
+        return optimize<EpsMaxEvaluator>(job, window, parameters);
     } else {
         ErSEvaluator::parameters_t parameters;
         parameters.max_iter = max_iter;
         parameters.test_vectors_n = test_vectors_n;
-        log_string = optimizeAndRewrite<ErSEvaluator>(module, parameters);
+        parameters.power_objective = power_objective;
+        parameters.batch_size = batch_size;
+        parameters.screen = screen;
+        parameters.distributions = &distributions.at(job.module->name);
+        parameters.golden_path = golden_path;
+        parameters.golden_key = fnv1a(job.key);
+        return optimize<ErSEvaluator>(job, window, parameters);
     }
-
-    log_header(module->design, "Rolling-back all rewrites.\n");
-    log_pop();
-
-    // 5. Output results
-    log_header(module->design, "Showing archive of results.\n");
-    log("%s", log_string.c_str());
-
-    // +1. Close our db cache
-    assert(sqlite3_close(db) == SQLITE_OK);
-    db = nullptr;
 }
 
 template<typename E>
-string AlsWorker::optimizeAndRewrite(Module *const module, typename E::parameters_t parameters) {
-    // 3. Optimize circuit and show results
-    log_header(module->design, "Running approximation heuristic.\n");
-    auto optimizer = Optimizer<E>(module, weights, synthesized_luts);
+std::string AlsWorker::optimize(const job_t &job, const size_t window, typename E::parameters_t parameters) {
+    // Windows have no weights, as their outputs are mostly cut signals, and no golden outputs
+    if (window < job.windows.size()) {
+        parameters.golden_path.clear();
+        weights_t window_weights;
+        Optimizer<E> optimizer(job.windows[window], window_weights, synthesized_luts);
+        optimizer.setup(parameters);
+        return write_front<E>(optimizer());
+    }
+
+    // 3. Optimize circuit, or compose the fronts of its windows, and show results
+    Optimizer<E> optimizer(job.module, weights.at(job.module->name), synthesized_luts);
     optimizer.setup(parameters);
-    auto archive = optimizer();
+    archive_t<E> archive;
+    if (job.windows.empty()) {
+        archive = optimizer();
+    } else {
+        std::vector<archive_t<E>> fronts;
+        for (size_t w = 0; w < job.windows.size(); w++)
+            fronts.push_back(read_front<E>(job.windows[w], job.fronts[w]));
+        archive = optimizer.compose(fronts);
+    }
+    auto log_string = print_archive(optimizer, archive);
+
+    std::vector<variant_t> variants;
+    for (auto &entry : archive) {
+        variant_t variant;
+        for (auto &v : entry.first) {
+            if (is_lut(v.first.cell)) {
+                auto &aig = synthesized_luts.at(get_lut_param(v.first.cell))[v.second];
+                std::string fun_spec_s;
+                boost::to_string(aig.fun_spec, fun_spec_s);
+                variant.levels[v.first.name] = v.second;
+                variant.luts[v.first.name] = Const::from_string(fun_spec_s);
+                variant.gates += aig.num_gates;
+            }
+        }
+        variant.value = {{entry.second[0], entry.second[1]}};
+        variant.power = optimizer.power(entry.first);
+
+        auto fidelity = optimizer.fidelity(entry.first);
+        variant.samples = fidelity.samples;
+        variant.exhaustive = fidelity.exhaustive;
+        variant.error_bounds = fidelity.bounds;
+        variants.push_back(variant);
+    }
+
+    std::ostringstream os;
+    os << log_string.size() << "\n" << log_string;
+    write_variant_set(os, variants);
+    return os.str();
+}
 
+void AlsWorker::write_variants(Module *const module, const std::vector<variant_t> &variants,
+                               const std::string &log_string) {
     // 4. Save results
     log_header(module->design, "Saving archive of results.\n");
     log_push();
@@ -112,106 +426,231 @@ string AlsWorker::optimizeAndRewrite(Module *const module, typename E::parameter
     boost::filesystem::path dir_path(dir_name.c_str());
     boost::filesystem::create_directory(dir_path); // TODO Please check for errors
 
-    auto log_string = print_archive(optimizer, archive);
     std::ofstream log_file;
     log_file.open(dir_name + "/log.txt");
     log_file << log_string;
     log_file.close();
 
-    std::string command = "write_ilang";
-    Pass::call(module->design, command + " " + dir_name + "/exact.ilang");
+    // The exact circuit is written once, variants only as the LUTs they change
+    Pass::call(module->design, "write_ilang " + dir_name + "/exact.ilang");
 
-    hashlib::dict<IdString, Const> to_restore;
-    for (auto cell : module->cells()) {
-        if (is_lut(cell))
-            to_restore[cell->name] = get_lut_param(cell);
-    }
+    std::ofstream variants_file(dir_name + "/variants.txt");
+    write_variant_set(variants_file, variants);
+    log("Wrote %zu variants to %s/variants.txt.\n", variants.size(), dir_name.c_str());
 
-    for (size_t i = 0; i < archive.size(); i++) {
-        log_header(module->design, "Rewriting variant %zu.\n", i);
-        std::string file_name("variant_");
-        file_name += std::to_string(i + 1);
-        for (auto &v : archive[i].first) {
-            if (is_lut(v.first.cell)) {
-                auto aig = synthesized_luts[get_lut_param(v.first.cell)][v.second];
-                std::string fun_spec_s;
-                boost::to_string(aig.fun_spec, fun_spec_s);
-                log("Rewriting %s with %s\n",
-                    get_lut_param(v.first.cell).as_string().c_str(), fun_spec_s.c_str());
-                v.first.cell->setParam("\\LUT", Const::from_string(fun_spec_s));
-            }
-        }
-        Pass::call(module->design, command + " " + dir_name + "/" + file_name + ".ilang");
+    std::ofstream json_file(dir_name + "/archive.json");
+    write_archive_json(json_file, module->name.c_str() + 1, metric, variants);
+    std::ofstream csv_file(dir_name + "/archive.csv");
+    write_archive_csv(csv_file, variants);
+    log("Wrote the archive report to %s/archive.json and %s/archive.csv.\n", dir_name.c_str(), dir_name.c_str());
+}
+
+void AlsWorker::estimate_luts(Module *const module, std::vector<variant_t> &variants) const {
+    log_header(module->design, "Estimating the size of the variants in 6-input LUTs.\n");
+    auto worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+    log("Mapping %zu variants with %u workers.\n", variants.size(), worker_count);
+    log_flush();
 
+    // Each variant is rewritten and mapped in a worker, which reports the count and the depth of its LUTs
+    std::vector<std::string> names;
+    for (size_t i = 0; i < variants.size(); i++)
+        names.push_back("variant " + std::to_string(i));
+
+    auto task = [&](size_t i) {
+        std::vector<Cell *> to_sub;
         for (auto cell : module->cells()) {
             if (is_lut(cell))
-                cell->setParam("\\LUT", to_restore[cell->name]);
+                to_sub.push_back(cell);
         }
-    }
-    return log_string;
+
+        AigRewriter rewriter(module);
+        for (auto cell : to_sub) {
+            auto level = variants[i].levels.find(cell->name);
+            auto &models = synthesized_luts.at(get_lut_param(cell));
+            rewriter.replace(cell, models.at(level != variants[i].levels.end() ? level->second : 0));
+        }
+        Pass::call_on_module(module->design, module, "clean");
+        Pass::call_on_module(module->design, module, "abc -lut 6");
+
+        size_t count = 0;
+        for (auto cell : module->cells()) {
+            if (cell->type == "$lut")
+                count++;
+        }
+        return std::to_string(count) + " " + std::to_string(lut_depth(module));
+    };
+
+    auto done = [&](size_t i, const std::string &result) {
+        std::istringstream in(result);
+        auto &variant = variants[i];
+        in >> variant.lut6_count >> variant.lut6_depth;
+        variant.estimated = true;
+        log("Variant %zu: %zu LUTs, depth %zu.\n", i, variant.lut6_count, variant.lut6_depth);
+    };
+
+    // The size is only reported, so a variant that cannot be mapped is warned about and left unestimated
+    run_forked(names, task, done, worker_count, false);
 }
 
-void AlsWorker::replace_lut(Module *const module, Cell *const lut, const aig_model_t &aig) {
-    // Vector of variables in the model
-    std::array<SigSpec, 2> vars;
-    vars[1].append(State::S0);
-
-    // Get LUT ins and outs
-    SigSpec lut_out;
-    for (auto &conn : lut->connections()) {
-        if (lut->input(conn.first))
-            vars[1].append(conn.second);
-        else if (lut->output(conn.first))
-            lut_out = conn.second;
-    }
+std::string AlsWorker::result_key(Module *const module) const {
+    std::ostringstream os;
+    os << "metric " << metric << "\n"
+       << "max_iter " << max_iter << "\n"
+       << "max_tries " << max_tries << "\n"
+       << "test_vectors " << test_vectors_n << "\n"
+       << "batch " << batch_size << "\n"
+       << "screen " << screen << "\n"
+       << "power " << power_objective << "\n"
+       << "window " << window_size << "\n"
+       << "seed " << (seed ? std::to_string(*seed) : "random") << "\n"
+       << "encoding " << smt_encoding_version << "\n";
+    for (auto &w : weights.at(module->name))
+        os << "weight " << log_signal(w.first) << " " << w.second << "\n";
+    for (auto &d : distributions.at(module->name))
+        os << d.to_string() << "\n";
+    os << dump_module(module);
+
+    return os.str();
+}
 
-    // Create AND gates
-    std::array<std::vector<Wire *>, 2> and_ab;
-    for (size_t i = 0; i < aig.num_gates; i++) {
-        Wire *and_a = module->addWire(NEW_ID);
-        Wire *and_b = module->addWire(NEW_ID);
-        Wire *and_y = module->addWire(NEW_ID);
-        module->addAndGate(NEW_ID, and_a, and_b, and_y);
-        and_ab[0].push_back(and_a);
-        and_ab[1].push_back(and_b);
-        vars[1].append(and_y);
-    }
+Module *AlsWorker::restore_results(Module *module, const std::string &dir, const std::string &key,
+                                   std::vector<variant_t> &variants, std::string &log_string) {
+    // The full key is compared, so that hash collisions are harmless
+    std::string cached_key;
+    if (!read_file(dir + "/key.txt", cached_key) || cached_key != key ||
+        !read_file(dir + "/log.txt", log_string))
+        return nullptr;
+
+    std::ifstream variants_file(dir + "/variants.txt");
+    if (!read_variant_set(variants_file, variants))
+        return nullptr;
+
+    log_header(module->design, "Restoring results of a previous run from %s.\n", dir.c_str());
+    auto design = module->design;
+    auto name = module->name;
+    design->remove(module);
+    Pass::call(design, "read_ilang " + dir + "/mapped.ilang");
+    module = design->module(name);
+    if (module == nullptr)
+        log_error("Cannot restore module %s from %s.\n", log_id(name), dir.c_str());
+
+    // The slice of the catalogue holds all the models of the module, so nothing is synthesized
+    close_catalogue();
+    catalogue.reset(new Catalogue(dir + "/luts.db", false));
+    log_header(design, "Running SMT exact synthesis for LUTs.\n");
+    exact_synthesis_helper({module});
+
+    return module;
+}
+
+void AlsWorker::save_results(Module *const module, const std::string &dir, const std::string &key,
+                             const std::string &mapped, const std::vector<variant_t> &variants,
+                             const std::string &log_string) const {
+    // Write to a temporary directory and rename it, so that concurrent runs never see partial results
+    std::string tmp_dir = dir + ".tmp." + std::to_string(getpid());
+
+    try {
+        boost::filesystem::create_directories(tmp_dir);
+
+        std::ofstream key_file(tmp_dir + "/key.txt");
+        key_file << key;
+        std::ofstream mapped_file(tmp_dir + "/mapped.ilang");
+        mapped_file << mapped;
+        std::ofstream log_file(tmp_dir + "/log.txt");
+        log_file << log_string;
+
+        std::ofstream variants_file(tmp_dir + "/variants.txt");
+        write_variant_set(variants_file, variants);
+
+        if (!key_file || !mapped_file || !log_file || !variants_file)
+            throw std::runtime_error("Cannot write results.");
+        key_file.close();
+        mapped_file.close();
+        log_file.close();
+        variants_file.close();
+
+        {
+            std::set<Const> module_luts;
+            for (auto cell : module->cells()) {
+                if (is_lut(cell))
+                    module_luts.insert(get_lut_param(cell));
+            }
+
+            // Only the models of this module, as the index may hold those of others
+            Catalogue slice(tmp_dir + "/luts.db", false);
+            std::vector<std::pair<std::string, aig_model_t>> entries;
+            std::vector<std::string> timeouts;
+            for (auto &lut : synthesized_luts) {
+                if (!module_luts.count(lut.first))
+                    continue;
+
+                auto &models = lut.second;
+                for (size_t dist = 0; dist < models.size(); dist++)
+                    entries.emplace_back(lut.first.as_string() + "@" + std::to_string(dist), models[dist]);
+
+                // Approximation stopped at a time-out rather than at a constant
+                if (!models.empty() && models.back().num_gates > 0)
+                    timeouts.push_back(lut.first.as_string() + "@" + std::to_string(models.size()));
+            }
 
-    // Negate variables
-    for (auto &sig : vars[1]) {
-        Wire *not_y = module->addWire(NEW_ID);
-        module->addNotGate(NEW_ID, sig, not_y);
-        vars[0].append(not_y);
+            if (!slice.insert(entries) || !slice.insert_timeout(timeouts, max_tries))
+                throw std::runtime_error("Cannot write catalogue slice.");
+        }
+
+        boost::filesystem::remove_all(dir);
+        boost::filesystem::rename(tmp_dir, dir);
+    } catch (const std::exception &e) {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(tmp_dir, ec);
+        log_warning("Cannot store results in %s: %s\n", dir.c_str(), e.what());
     }
+}
+
+void AlsWorker::open_catalogue() {
+    catalogue.reset(new Catalogue(catalogue_path));
+    catalogue->write_behind();
+}
 
-    // Create connections
-    assert(GetSize(and_ab[0]) == GetSize(and_ab[1]));
-    assert(GetSize(vars[0]) == GetSize(vars[1]));
-    for (int i = 0; i < GetSize(and_ab[0]); i++) {
-        for (int c = 0; c < GetSize(and_ab); c++) {
-            int g_idx = aig.num_inputs + i;
-            int p = aig.p[g_idx][c];
-            int s = aig.s[g_idx][c];
-            module->connect(and_ab[c][i], vars[p][s]);
+void AlsWorker::close_catalogue() {
+    if (catalogue && !catalogue->flush())
+        log_warning("Cannot store some entries in the catalogue %s.\n", catalogue_path.c_str());
+    catalogue.reset();
+}
+
+void AlsWorker::rewrite_luts(Module *const module) {
+    log_header(module->design, "Rewriting the AIG of module %s.\n", log_id(module));
+    Pass::call_on_module(module->design, module, "clean");
+
+    std::vector<Cell *> to_sub;
+    for (auto cell : module->cells()) {
+        if (is_lut(cell)) {
+            to_sub.push_back(cell);
         }
     }
-    module->connect(lut_out, vars[aig.out_p][aig.out]);
 
-    // Delete LUT
-    module->remove(lut);
+    AigRewriter rewriter(module);
+    for (auto cell : to_sub) {
+        // We get without doubts here - if we used it in a solution, we MUST have its synth
+        rewriter.replace(cell, synthesize_lut(get_lut_param(cell), 0, max_tries, debug, catalogue.get()));
+    }
+    log("Replaced %zu LUTs with %zu gates.\n", to_sub.size(), rewriter.gates());
+
+    Pass::call_on_module(module->design, module, "clean");
 }
 
-void AlsWorker::exact_synthesis_helper(Module *module) {
+void AlsWorker::exact_synthesis_helper(const std::vector<Module *> &modules) {
     auto processor_count = std::thread::hardware_concurrency();
-    processor_count = std::min(processor_count, 1u);
+    processor_count = std::max(processor_count, 1u);
     std::vector<dict<Const, std::vector<aig_model_t>>> result_slices(processor_count);
 
     // In this simple implementation we pay SMT with bookkeeping
     std::set<Yosys::Const> unique_luts_set;
     std::vector<Yosys::Const> unique_luts;
-    for (auto cell : module->cells()) {
-        if (is_lut(cell)) {
-            unique_luts_set.insert(get_lut_param(cell));
+    for (auto module : modules) {
+        for (auto cell : module->cells()) {
+            if (is_lut(cell)) {
+                unique_luts_set.insert(get_lut_param(cell));
+            }
         }
     }
     std::copy(unique_luts_set.begin(), unique_luts_set.end(), std::back_inserter(unique_luts));
@@ -236,11 +675,11 @@ void AlsWorker::exact_synthesis_helper(Module *module) {
                 const auto &fun_spec = unique_luts[i];
 
                 result_slices[j][fun_spec] =
-                        std::vector<aig_model_t>{synthesize_lut(fun_spec, 0, max_tries, debug, db)};
+                        std::vector<aig_model_t>{synthesize_lut(fun_spec, 0, max_tries, debug, catalogue.get())};
 
                 size_t dist = 1;
                 while (result_slices[j][fun_spec].back().num_gates > 0) {
-                    auto approximate_candidate = synthesize_lut(fun_spec, dist++, max_tries, debug, db);
+                    auto approximate_candidate = synthesize_lut(fun_spec, dist++, max_tries, debug, catalogue.get());
                     if (approximate_candidate.is_valid)
                         result_slices[j][fun_spec].push_back(std::move(approximate_candidate));
                     else
@@ -0,0 +1,894 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Cache of synthesized LUTs for Yosys ALS module
+ */
+
+#include "Catalogue.h"
+
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/array.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+namespace boost {
+namespace serialization {
+
+template<class Archive>
+void serialize(Archive &ar, yosys_als::aig_model_t &aig,
+               const unsigned int version __attribute__((unused))) {
+    ar & aig.is_valid;
+    ar & aig.fun_spec;
+    ar & aig.num_inputs;
+    ar & aig.num_gates;
+    ar & aig.s;
+    ar & aig.p;
+    ar & aig.out;
+    ar & aig.out_p;
+}
+
+template<typename Ar, typename Block, typename Alloc>
+void save(Ar &ar, dynamic_bitset<Block, Alloc> const &bs, unsigned) {
+    size_t num_bits = bs.size();
+    std::vector<Block> blocks(bs.num_blocks());
+    to_block_range(bs, blocks.begin());
+
+    ar & num_bits & blocks;
+}
+
+template<typename Ar, typename Block, typename Alloc>
+void load(Ar &ar, dynamic_bitset<Block, Alloc> &bs, unsigned) {
+    size_t num_bits;
+    std::vector<Block> blocks;
+    ar & num_bits & blocks;
+
+    bs.resize(num_bits);
+    from_block_range(blocks.begin(), blocks.end(), bs);
+    bs.resize(num_bits);
+}
+
+template<typename Ar, typename Block, typename Alloc>
+void serialize(Ar &ar, dynamic_bitset<Block, Alloc> &bs, unsigned version) {
+    split_free(ar, bs, version);
+}
+
+}
+}
+
+namespace yosys_als {
+
+/*
+ * Utility functions and procedures
+ */
+
+/// Condition under which a stored model is replaced by a new one, in an upsert on \c luts
+static const std::string better_lut = "excluded.version > luts.version or (excluded.version = luts.version and "
+                                      "(excluded.optimal > luts.optimal or (excluded.optimal = luts.optimal and "
+                                      "excluded.gates < luts.gates)))";
+
+/// Merges time-outs in an upsert on \c timeouts, discarding those of older encodings
+static const std::string merge_timeouts = "do update set max_tries = case when excluded.version > timeouts.version "
+                                          "then excluded.max_tries else max(timeouts.max_tries, excluded.max_tries) end, "
+                                          "version = excluded.version where excluded.version >= timeouts.version";
+
+/**
+ * @brief Checks if a model is better than another for the same key
+ * @return \c true if \p a is proven minimal and \p b is not, or if it has fewer gates otherwise
+ */
+static bool is_better(const aig_model_t &a, const aig_model_t &b) {
+    if (a.is_optimal != b.is_optimal)
+        return a.is_optimal;
+
+    return a.num_gates < b.num_gates;
+}
+
+/*
+ * Exposed methods
+ */
+
+Catalogue::Catalogue(const std::string &path, bool use_snapshot) : path(path) {
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::string msg = "Cannot open catalogue " + path + ": " + sqlite3_errmsg(db);
+        sqlite3_close(db);
+        throw std::runtime_error(msg);
+    }
+
+    // Wait on locks held by other processes instead of failing with SQLITE_BUSY
+    sqlite3_busy_timeout(db, busy_timeout);
+    sqlite3_exec(db, "pragma journal_mode = wal;", 0, 0, 0);
+
+    std::string query = "create table if not exists usage (arity integer not null, distance integer not null, "
+                        "hits integer not null, misses integer not null, primary key (arity, distance));"
+                        "create table if not exists claims (spec text not null, owner text not null, "
+                        "expires integer not null, primary key (spec));";
+    if (sqlite3_exec(db, query.c_str(), 0, 0, 0) != SQLITE_OK) {
+        std::string msg = "Cannot initialize catalogue " + path + ": " + sqlite3_errmsg(db);
+        sqlite3_close(db);
+        throw std::runtime_error(msg);
+    }
+
+    try {
+        create_tables("main");
+    } catch (const std::runtime_error &e) {
+        sqlite3_close(db);
+        throw std::runtime_error("Cannot initialize catalogue " + path + ": " + e.what());
+    }
+
+    char host[256] = {0};
+    gethostname(host, sizeof(host) - 1);
+    owner = std::string(host) + ":" + std::to_string(getpid());
+
+    // With a snapshot, the database is never scanned as a whole
+    if (use_snapshot && access(snapshot_path(path).c_str(), R_OK) == 0) {
+        try {
+            snapshot.reset(new Snapshot(snapshot_path(path)));
+            loaded = true;
+        } catch (const std::runtime_error &) {
+            // The snapshot is stale or corrupt: fall back to the database until it is compiled again
+        }
+    }
+}
+
+Catalogue::~Catalogue() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        writer.join();
+    }
+
+    flush_usage();
+    sqlite3_close(db);
+}
+
+bool Catalogue::lookup(const std::string &key, aig_model_t &aig) {
+    if (snapshot && snapshot->lookup(key, aig))
+        return true;
+
+    preload();
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    auto entry = index.find(key);
+    if (entry == index.end())
+        return false;
+
+    aig = entry->second;
+    return true;
+}
+
+bool Catalogue::fetch(const std::string &key, aig_model_t &aig) {
+    std::string serialized;
+    bool optimal = false;
+
+    {
+        std::lock_guard<std::mutex> lock(db_mtx);
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, "select aig, optimal from luts where spec = ? and version = ?;", -1, &stmt, 0);
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, smt_encoding_version);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            serialized = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            optimal = sqlite3_column_int(stmt, 1) != 0;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (serialized.empty())
+        return false;
+
+    aig = aig_from_string(serialized);
+    aig.is_optimal = optimal;
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    index[key] = aig;
+    return true;
+}
+
+bool Catalogue::insert(const std::string &key, const aig_model_t &aig) {
+    return insert(std::vector<std::pair<std::string, aig_model_t>>{{key, aig}});
+}
+
+bool Catalogue::insert(const std::vector<std::pair<std::string, aig_model_t>> &entries) {
+    preload();
+
+    std::vector<std::pair<std::string, aig_model_t>> to_write;
+    {
+        std::lock_guard<std::mutex> lock(index_mtx);
+        for (auto &entry : entries) {
+            auto indexed = index.find(entry.first);
+            if (indexed == index.end() || is_better(entry.second, indexed->second)) {
+                index[entry.first] = entry.second;
+                to_write.push_back(entry);
+            }
+        }
+    }
+
+    if (to_write.empty())
+        return true;
+
+    // Write back outside of the index lock, so that lookups from other threads are not blocked
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            std::move(to_write.begin(), to_write.end(), std::back_inserter(queued_luts));
+        }
+        queue_cv.notify_one();
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    return write_luts(to_write);
+}
+
+bool Catalogue::timed_out(const std::string &key, unsigned int max_tries) {
+    preload();
+
+    {
+        std::lock_guard<std::mutex> lock(index_mtx);
+        auto entry = timeouts.find(key);
+        if (entry != timeouts.end() && entry->second >= max_tries)
+            return true;
+    }
+
+    // Another process may have recorded a larger budget after our index was loaded
+    unsigned int budget = 0;
+    {
+        std::lock_guard<std::mutex> lock(db_mtx);
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, "select max_tries from timeouts where spec = ? and version = ?;", -1, &stmt, 0);
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, smt_encoding_version);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            budget = static_cast<unsigned int>(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+    }
+
+    if (budget == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    timeouts[key] = std::max(timeouts[key], budget);
+    return budget >= max_tries;
+}
+
+bool Catalogue::insert_timeout(const std::string &key, unsigned int max_tries) {
+    return insert_timeout(std::vector<std::string>{key}, max_tries);
+}
+
+bool Catalogue::insert_timeout(const std::vector<std::string> &keys, unsigned int max_tries) {
+    preload();
+
+    std::vector<std::pair<std::string, unsigned int>> to_write;
+    {
+        std::lock_guard<std::mutex> lock(index_mtx);
+        for (auto &key : keys) {
+            timeouts[key] = std::max(timeouts[key], max_tries);
+            to_write.emplace_back(key, max_tries);
+        }
+    }
+
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            std::move(to_write.begin(), to_write.end(), std::back_inserter(queued_timeouts));
+        }
+        queue_cv.notify_one();
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    return write_timeouts(to_write);
+}
+
+bool Catalogue::claim(const std::string &key) {
+    std::lock_guard<std::mutex> lock(db_mtx);
+    auto now = static_cast<sqlite3_int64>(std::time(nullptr));
+
+    // Take the write lock up-front, so that checking and claiming is atomic across processes
+    if (sqlite3_exec(db, "begin immediate;", 0, 0, 0) != SQLITE_OK)
+        return false;
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "delete from claims where spec = ? and expires < ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, now);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "insert or ignore into claims values (?, ?, ?);", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, owner.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, now + lease);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    bool ours = false;
+    sqlite3_prepare_v2(db, "select owner from claims where spec = ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        ours = owner == reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "commit;", 0, 0, 0) != SQLITE_OK) {
+        sqlite3_exec(db, "rollback;", 0, 0, 0);
+        return false;
+    }
+
+    return ours;
+}
+
+void Catalogue::release(const std::string &key) {
+    // Queued after the result, so that waiting processes find it once the claim is gone
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            queued_releases.push_back(key);
+        }
+        queue_cv.notify_one();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    write_release(key);
+}
+
+bool Catalogue::wait_for(const std::string &key, aig_model_t &aig) {
+    while (true) {
+        if (fetch(key, aig))
+            return true;
+
+        bool claimed;
+        {
+            std::lock_guard<std::mutex> lock(db_mtx);
+            sqlite3_stmt *stmt;
+            sqlite3_prepare_v2(db, "select 1 from claims where spec = ? and expires >= ?;", -1, &stmt, 0);
+            sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(std::time(nullptr)));
+            claimed = sqlite3_step(stmt) == SQLITE_ROW;
+            sqlite3_finalize(stmt);
+        }
+
+        // The claim was released or expired: look for the result one last time
+        if (!claimed)
+            return fetch(key, aig);
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+void Catalogue::write_behind() {
+    if (!writer.joinable())
+        writer = std::thread(&Catalogue::drain, this);
+}
+
+bool Catalogue::flush() {
+    std::unique_lock<std::mutex> lock(queue_mtx);
+    drained_cv.wait(lock, [this]() {
+        return !writing && queued_luts.empty() && queued_timeouts.empty() && queued_releases.empty();
+    });
+
+    bool ok = failed_writes == 0;
+    failed_writes = 0;
+    return ok;
+}
+
+size_t Catalogue::size() {
+    preload();
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    return index.size();
+}
+
+std::vector<std::pair<std::string, aig_model_t>> Catalogue::entries() {
+    preload();
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    return std::vector<std::pair<std::string, aig_model_t>>(index.begin(), index.end());
+}
+
+void Catalogue::erase(const std::string &key) {
+    flush();
+
+    preload();
+
+    {
+        std::lock_guard<std::mutex> lock(index_mtx);
+        index.erase(key);
+    }
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "delete from luts where spec = ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+void Catalogue::count(const std::string &key, bool hit) {
+    unsigned int arity, distance;
+    if (!parse_key(key, arity, distance))
+        return;
+
+    std::lock_guard<std::mutex> lock(usage_mtx);
+    auto &counters = usage[{arity, distance}];
+    if (hit)
+        counters.first++;
+    else
+        counters.second++;
+}
+
+std::map<std::pair<unsigned int, unsigned int>, catalogue_stats_t> Catalogue::stats() {
+    std::map<std::pair<unsigned int, unsigned int>, catalogue_stats_t> result;
+    flush();
+    flush_usage();
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    sqlite3_stmt *stmt;
+    unsigned int arity, distance;
+
+    sqlite3_prepare_v2(db, "select spec, length(aig), version, optimal from luts;", -1, &stmt, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        auto spec = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        if (spec != nullptr && parse_key(spec, arity, distance)) {
+            auto &entry = result[{arity, distance}];
+            entry.bytes += sqlite3_column_int64(stmt, 1);
+            if (sqlite3_column_int(stmt, 2) != static_cast<int>(smt_encoding_version)) {
+                entry.stale++;
+            } else {
+                entry.entries++;
+                if (sqlite3_column_int(stmt, 3) != 0)
+                    entry.optimal++;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "select spec, version from timeouts;", -1, &stmt, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        auto spec = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        if (spec != nullptr && parse_key(spec, arity, distance)) {
+            if (sqlite3_column_int(stmt, 1) != static_cast<int>(smt_encoding_version))
+                result[{arity, distance}].stale++;
+            else
+                result[{arity, distance}].timeouts++;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, "select arity, distance, hits, misses from usage;", -1, &stmt, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        auto &entry = result[{static_cast<unsigned int>(sqlite3_column_int(stmt, 0)),
+                              static_cast<unsigned int>(sqlite3_column_int(stmt, 1))}];
+        entry.hits = sqlite3_column_int64(stmt, 2);
+        entry.misses = sqlite3_column_int64(stmt, 3);
+    }
+    sqlite3_finalize(stmt);
+
+    return result;
+}
+
+size_t Catalogue::write_snapshot() {
+    return Snapshot::write(snapshot_path(path), entries());
+}
+
+std::string Catalogue::snapshot_path(const std::string &path) {
+    return path + ".snap";
+}
+
+size_t Catalogue::file_size() {
+    std::lock_guard<std::mutex> lock(db_mtx);
+    sqlite3_stmt *stmt;
+    size_t size = 0;
+
+    sqlite3_prepare_v2(db, "select page_count * page_size from pragma_page_count(), pragma_page_size();",
+                       -1, &stmt, 0);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        size = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    return size;
+}
+
+void Catalogue::vacuum() {
+    flush();
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    exec("delete from claims where expires < " + std::to_string(std::time(nullptr)) + ";");
+    exec("vacuum;");
+}
+
+size_t Catalogue::invalidate(bool suboptimal) {
+    flush();
+
+    size_t removed = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(db_mtx);
+        auto version = std::to_string(smt_encoding_version);
+
+        try {
+            exec("begin immediate;");
+            exec("delete from luts where version <> " + version + (suboptimal ? " or optimal = 0;" : ";"));
+            removed += sqlite3_changes(db);
+            exec("delete from timeouts where version <> " + version + ";");
+            removed += sqlite3_changes(db);
+            exec("commit;");
+        } catch (const std::runtime_error &) {
+            sqlite3_exec(db, "rollback;", 0, 0, 0);
+            throw;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    if (suboptimal) {
+        for (auto it = index.begin(); it != index.end();)
+            it = it->second.is_optimal ? std::next(it) : index.erase(it);
+    }
+
+    return removed;
+}
+
+size_t Catalogue::export_bundle(const std::string &path) {
+    flush();
+    flush_usage();
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "attach database ? as bundle;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error("Cannot open bundle " + path + ": " + sqlite3_errmsg(db));
+
+    size_t exported = 0;
+    try {
+        exec("begin;");
+        create_tables("bundle");
+        exported = merge("main", "bundle");
+        exec("commit;");
+    } catch (const std::runtime_error &) {
+        sqlite3_exec(db, "rollback;", 0, 0, 0);
+        sqlite3_exec(db, "detach database bundle;", 0, 0, 0);
+        throw;
+    }
+    exec("detach database bundle;");
+
+    return exported;
+}
+
+size_t Catalogue::import_bundle(const std::string &path) {
+    flush();
+
+    std::lock_guard<std::mutex> lock(db_mtx);
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "attach database ? as bundle;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error("Cannot open bundle " + path + ": " + sqlite3_errmsg(db));
+
+    size_t imported = 0;
+    try {
+        // Bundles written before models were versioned hold stale entries only
+        if (!has_column("bundle", "luts", "version"))
+            throw std::runtime_error("Bundle " + path + " holds entries of an older encoding.");
+
+        exec("begin;");
+        imported = merge("bundle", "main");
+        exec("commit;");
+    } catch (const std::runtime_error &) {
+        sqlite3_exec(db, "rollback;", 0, 0, 0);
+        sqlite3_exec(db, "detach database bundle;", 0, 0, 0);
+        throw;
+    }
+    exec("detach database bundle;");
+
+    // Imported entries must be visible to following lookups
+    std::lock_guard<std::mutex> index_lock(index_mtx);
+    loaded = false;
+    index.clear();
+    timeouts.clear();
+
+    return imported;
+}
+
+/*
+ * Private methods
+ */
+
+void Catalogue::preload() {
+    std::lock_guard<std::mutex> lock(index_mtx);
+    if (loaded)
+        return;
+
+    // One sequential scan instead of a query per lookup
+    std::lock_guard<std::mutex> db_lock(db_mtx);
+    auto version = std::to_string(smt_encoding_version);
+    std::string query = "select spec, aig, optimal from luts where version = " + version + ";";
+    sqlite3_exec(db, query.c_str(),
+                 [](void *index, int argc, char **argv, char **azColName) {
+                     (void) argc;
+                     (void) azColName;
+
+                     auto *the_index = (std::unordered_map<std::string, aig_model_t> *) index;
+                     auto aig = aig_from_string(argv[1]);
+                     aig.is_optimal = std::string(argv[2]) != "0";
+                     the_index->emplace(argv[0], aig);
+
+                     return 0;
+                 }, (void *) &index, 0);
+
+    query = "select spec, max_tries from timeouts where version = " + version + ";";
+    sqlite3_exec(db, query.c_str(),
+                 [](void *timeouts, int argc, char **argv, char **azColName) {
+                     (void) argc;
+                     (void) azColName;
+
+                     auto *the_timeouts = (std::unordered_map<std::string, unsigned int> *) timeouts;
+                     (*the_timeouts)[argv[0]] = std::stoul(argv[1]);
+
+                     return 0;
+                 }, (void *) &timeouts, 0);
+
+    loaded = true;
+}
+
+void Catalogue::drain() {
+    std::unique_lock<std::mutex> lock(queue_mtx);
+
+    while (true) {
+        queue_cv.wait(lock, [this]() {
+            return stopping || !queued_luts.empty() || !queued_timeouts.empty() || !queued_releases.empty();
+        });
+        if (queued_luts.empty() && queued_timeouts.empty() && queued_releases.empty())
+            break;
+
+        // Take the whole queue, so that producers can go on while the batch is written
+        std::vector<std::pair<std::string, aig_model_t>> luts;
+        std::vector<std::pair<std::string, unsigned int>> timeouts_batch;
+        std::vector<std::string> releases;
+        luts.swap(queued_luts);
+        timeouts_batch.swap(queued_timeouts);
+        releases.swap(queued_releases);
+        writing = true;
+        lock.unlock();
+
+        bool ok;
+        {
+            std::lock_guard<std::mutex> db_lock(db_mtx);
+            ok = write_luts(luts);
+            ok = write_timeouts(timeouts_batch) && ok;
+            for (auto &key : releases)
+                write_release(key);
+        }
+
+        lock.lock();
+        if (!ok)
+            failed_writes++;
+        writing = false;
+        drained_cv.notify_all();
+    }
+}
+
+bool Catalogue::write_luts(const std::vector<std::pair<std::string, aig_model_t>> &entries) {
+    if (entries.empty())
+        return true;
+
+    if (sqlite3_exec(db, "begin immediate;", 0, 0, 0) != SQLITE_OK)
+        return false;
+
+    bool ok = true;
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, ("insert into luts values (?, ?, ?, ?, ?) on conflict (spec) do update set "
+                            "aig = excluded.aig, version = excluded.version, optimal = excluded.optimal, "
+                            "gates = excluded.gates where " + better_lut + ";").c_str(), -1, &stmt, 0);
+    for (auto &entry : entries) {
+        bind_lut(stmt, entry.first, entry.second);
+        ok = sqlite3_step(stmt) == SQLITE_DONE && ok;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "commit;", 0, 0, 0) != SQLITE_OK) {
+        sqlite3_exec(db, "rollback;", 0, 0, 0);
+        return false;
+    }
+
+    return ok;
+}
+
+bool Catalogue::write_timeouts(const std::vector<std::pair<std::string, unsigned int>> &entries) {
+    if (entries.empty())
+        return true;
+
+    if (sqlite3_exec(db, "begin immediate;", 0, 0, 0) != SQLITE_OK)
+        return false;
+
+    bool ok = true;
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, ("insert into timeouts values (?, ?, ?) on conflict (spec) " + merge_timeouts + ";").c_str(),
+                       -1, &stmt, 0);
+    for (auto &entry : entries) {
+        sqlite3_bind_text(stmt, 1, entry.first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, entry.second);
+        sqlite3_bind_int(stmt, 3, smt_encoding_version);
+        ok = sqlite3_step(stmt) == SQLITE_DONE && ok;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "commit;", 0, 0, 0) != SQLITE_OK) {
+        sqlite3_exec(db, "rollback;", 0, 0, 0);
+        return false;
+    }
+
+    return ok;
+}
+
+void Catalogue::write_release(const std::string &key) {
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "delete from claims where spec = ? and owner = ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, owner.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+void Catalogue::create_tables(const std::string &schema) {
+    exec("create table if not exists " + schema + ".luts (spec text not null, aig blob not null, "
+         "version integer not null default 0, optimal integer not null default 0, "
+         "gates integer not null default 0, primary key (spec));"
+         "create table if not exists " + schema + ".timeouts (spec text not null, max_tries integer not null, "
+         "version integer not null default 0, primary key (spec));");
+
+    // Tables created before models were versioned: their rows are left with version 0, i.e. stale
+    if (!has_column(schema, "luts", "version")) {
+        exec("alter table " + schema + ".luts add column version integer not null default 0;"
+             "alter table " + schema + ".luts add column optimal integer not null default 0;"
+             "alter table " + schema + ".luts add column gates integer not null default 0;");
+    }
+    if (!has_column(schema, "timeouts", "version"))
+        exec("alter table " + schema + ".timeouts add column version integer not null default 0;");
+}
+
+bool Catalogue::has_column(const std::string &schema, const std::string &table, const std::string &column) {
+    sqlite3_stmt *stmt;
+    bool found = false;
+
+    sqlite3_prepare_v2(db, ("pragma " + schema + ".table_info(" + table + ");").c_str(), -1, &stmt, 0);
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW)
+        found = column == reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    sqlite3_finalize(stmt);
+
+    return found;
+}
+
+size_t Catalogue::merge(const std::string &from, const std::string &to) {
+    exec("insert into " + to + ".luts select spec, aig, version, optimal, gates from " + from + ".luts "
+         "where true on conflict (spec) do update set aig = excluded.aig, version = excluded.version, "
+         "optimal = excluded.optimal, gates = excluded.gates where " + better_lut + ";");
+    size_t merged = sqlite3_changes(db);
+
+    exec("insert into " + to + ".timeouts select spec, max_tries, version from " + from + ".timeouts "
+         "where true on conflict (spec) " + merge_timeouts + ";");
+
+    return merged;
+}
+
+void Catalogue::bind_lut(sqlite3_stmt *stmt, const std::string &key, const aig_model_t &aig) {
+    auto serialized = aig_to_string(aig);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, serialized.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 3, smt_encoding_version);
+    sqlite3_bind_int(stmt, 4, aig.is_optimal);
+    sqlite3_bind_int64(stmt, 5, aig.num_gates);
+}
+
+void Catalogue::exec(const std::string &query) {
+    char *err = nullptr;
+    if (sqlite3_exec(db, query.c_str(), 0, 0, &err) != SQLITE_OK) {
+        std::string msg = err != nullptr ? err : "unknown error";
+        sqlite3_free(err);
+        throw std::runtime_error("Catalogue query failed: " + msg);
+    }
+}
+
+void Catalogue::flush_usage() {
+    std::lock_guard<std::mutex> lock(usage_mtx);
+    std::lock_guard<std::mutex> db_lock(db_mtx);
+
+    for (auto &counters : usage) {
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, "insert into usage values (?, ?, ?, ?) on conflict (arity, distance) "
+                               "do update set hits = hits + excluded.hits, misses = misses + excluded.misses;",
+                           -1, &stmt, 0);
+        sqlite3_bind_int(stmt, 1, counters.first.first);
+        sqlite3_bind_int(stmt, 2, counters.first.second);
+        sqlite3_bind_int64(stmt, 3, counters.second.first);
+        sqlite3_bind_int64(stmt, 4, counters.second.second);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+
+    usage.clear();
+}
+
+/*
+ * Serialization
+ */
+
+std::string aig_to_string(const aig_model_t &aig) {
+    std::ostringstream os;
+    boost::archive::text_oarchive oa(os);
+    oa << aig;
+
+    return os.str();
+}
+
+aig_model_t aig_from_string(const std::string &s) {
+    aig_model_t aig;
+    std::istringstream is(s);
+    boost::archive::text_iarchive ia(is);
+    ia >> aig;
+
+    return aig;
+}
+
+bool parse_key(const std::string &key, unsigned int &arity, unsigned int &distance) {
+    auto at = key.find('@');
+    if (at == std::string::npos || at == 0 || at + 1 == key.size())
+        return false;
+
+    // Corrupt keys are skipped, so the distance is parsed without throwing
+    const char *begin = key.c_str() + at + 1;
+    char *end;
+    errno = 0;
+    auto parsed = std::strtoul(begin, &end, 10);
+    if (!std::isdigit(static_cast<unsigned char>(*begin)) || *end != '\0' || errno == ERANGE ||
+        parsed > std::numeric_limits<unsigned int>::max())
+        return false;
+
+    arity = 0;
+    while ((1ul << arity) < at)
+        arity++;
+    distance = static_cast<unsigned int>(parsed);
+
+    return true;
+}
+}
@@ -24,6 +24,8 @@
 
 #include "EpsMaxEvaluator.h"
 
+#include <algorithm>
+#include <random>
 #include <thread>
 
 namespace yosys_als {
@@ -37,8 +39,6 @@ EpsMaxEvaluator::EpsMaxEvaluator(optimizer_context_t<EpsMaxEvaluator> *ctx) : ct
 }
 
 void EpsMaxEvaluator::setup(const parameters_t &parameters) {
-    (void) parameters;
-
     // Count gates baseline
     gates_baseline = gates(ctx->opt->empty_solution().first);
 
@@ -55,21 +55,95 @@ void EpsMaxEvaluator::setup(const parameters_t &parameters) {
             return ctx->g.g[v2].weight.has_value();
     });
 
-    for (size_t i = 0; i < 1ul << ctx->g.num_inputs; i++)
-        exact_outputs.emplace_back(evaluate_graph(ctx->opt->empty_solution().first,
-                                                  boost::dynamic_bitset<>(ctx->g.num_inputs, i)));
+    // Weights are the positions of the output bits, so the widest one sets the width of the outputs
+    for (auto &v : ctx->vertices) {
+        if (ctx->g.g[v].weight.has_value())
+            output_width = std::max(output_width, ctx->g.g[v].weight.get() + 1);
+    }
+
+    // All the vectors are evaluated in order, so golden outputs of a previous run on the same circuit are reused
+    auto exact_solution = ctx->opt->empty_solution().first;
+    size_t n_vectors = 1ul << ctx->g.num_inputs;
+    bool reused = false;
+    if (parameters.golden_path.empty())
+        exact_outputs.allocate(output_width, n_vectors);
+    else
+        reused = exact_outputs.map(parameters.golden_path, output_width, n_vectors, parameters.golden_key);
+
+    if (!reused) {
+        for (size_t b = 0; b < (n_vectors + 63) / 64; b++) {
+            auto outputs = evaluate_words(exact_solution, b);
+            for (size_t o = 0; o < output_width; o++)
+                exact_outputs.set_word(o, b, outputs[o]);
+        }
+        exact_outputs.commit();
+    }
+
+    // Toggles are counted on a fixed random sequence of vectors, not to draw from rng
+    std::default_random_engine activity_rng(ctx->g.num_inputs);
+    std::uniform_int_distribution<unsigned long> vector_dist(0, (1ul << ctx->g.num_inputs) - 1);
+    size_t activity_n = std::min(exact_outputs.vectors(), activity_vectors_n) + 1;
+    for (size_t i = 0; i < activity_n; i++)
+        activity_vectors.emplace_back(ctx->g.num_inputs, vector_dist(activity_rng));
 }
 
 EpsMaxEvaluator::value_t EpsMaxEvaluator::value(const solution_t &s) const {
-    return value_t{circuit_epsmax(s),
+    return value_t{error_stats(s).max_value(),
                    static_cast<double>(gates(s)) / gates_baseline};
 }
 
+EpsMaxEvaluator::value_t EpsMaxEvaluator::value(const solution_t &s, const archive_entry_t<EpsMaxEvaluator> &reference,
+                                                 bool &partial) const {
+    (void) reference;
+    partial = false;
+    return value(s);
+}
+
 EpsMaxEvaluator::value_t EpsMaxEvaluator::empty_solution_value(const solution_t &s) {
     (void) s;
     return {0, 1};
 }
 
+fidelity_t EpsMaxEvaluator::fidelity(const solution_t &s) const {
+    // All the input vectors are evaluated, so the error is exact
+    fidelity_t f;
+    f.samples = exact_outputs.vectors();
+    f.exhaustive = true;
+    f.bounds[0] = f.bounds[1] = error_stats(s).max_value();
+
+    return f;
+}
+
+sliced_stats_t EpsMaxEvaluator::error_stats(const solution_t &s) const {
+    sliced_stats_t stats(output_width);
+    size_t n_vectors = exact_outputs.vectors();
+    sliced_t exact(output_width);
+
+    for (size_t b = 0; b < (n_vectors + 63) / 64; b++) {
+        for (size_t o = 0; o < output_width; o++)
+            exact[o] = exact_outputs.row(o)[b];
+
+        // Circuits with less than 6 inputs only fill the first lanes
+        auto lanes = std::min<size_t>(64, n_vectors - b * 64);
+        uint64_t mask = lanes == 64 ? ~uint64_t(0) : (uint64_t(1) << lanes) - 1;
+        stats.add(sliced_abs_difference(evaluate_words(s, b), exact), mask);
+    }
+
+    return stats;
+}
+
+double EpsMaxEvaluator::power(const solution_t &s) const {
+    // The exact circuit is only simulated once power is needed for the results
+    if (activity_baseline < 0.0)
+        activity_baseline = switching_activity(ctx->opt->empty_solution().first);
+
+    // A circuit that never toggles only has equally quiet variants
+    if (activity_baseline == 0.0)
+        return 1.0;
+
+    return switching_activity(s) / activity_baseline;
+}
+
 bool EpsMaxEvaluator::dominates(const archive_entry_t<EpsMaxEvaluator> &s1,
                              const archive_entry_t<EpsMaxEvaluator> &s2, double arel_bias) {
     double arel1 = fabs(arel_bias - s1.second[0]);
@@ -84,22 +158,50 @@ bool EpsMaxEvaluator::dominates(const archive_entry_t<EpsMaxEvaluator> &s1,
  * Private methods
  */
 
-double EpsMaxEvaluator::circuit_epsmax(const solution_t &s) const {
-    double curr_epsmax = 0;
+double EpsMaxEvaluator::switching_activity(const solution_t &s) const {
+    // Vectors are packed in order and simulated 64 at a time, so that a toggle is a bit that differs
+    // from the one before it
+    size_t n = activity_vectors.size();
+    size_t n_words = (n + 63) / 64;
+    std::vector<std::vector<uint64_t>> words(boost::num_vertices(ctx->g.g));
+    std::vector<uint64_t> in_words;
+    double weighted_toggles = 0.0;
+    size_t curr_input = 0;
 
-    size_t n_vectors = 1ul << ctx->g.num_inputs;
+    for (auto &v : ctx->vertices) {
+        auto &vertex = ctx->g.g[v];
+        words[v].assign(n_words, 0);
+        if (boost::in_degree(v, ctx->g.g) == 0) {
+            if (vertex.type == vertex_t::PRIMARY_INPUT) {
+                for (size_t k = 0; k < n; k++) {
+                    if (activity_vectors[k][curr_input])
+                        words[v][k / 64] |= uint64_t(1) << (k % 64);
+                }
+                curr_input++;
+            } else if (vertex.type == vertex_t::CONSTANT_ONE) {
+                words[v].assign(n_words, ~uint64_t(0));
+            }
+            continue;
+        }
 
-    for (size_t i = 0; i < n_vectors; i++) {
-        auto result = abs(
-                static_cast<double>(evaluate_graph(s, boost::dynamic_bitset<>(ctx->g.num_inputs, i)).to_ulong())
-                - static_cast<double>(exact_outputs[i].to_ulong())
-                );
-        if (result > curr_epsmax) {
-            curr_epsmax = result;
+        // The first edge is the least significant input of the LUT
+        auto &aig = ctx->luts.at(get_lut_param(vertex.cell))[s.at(vertex)];
+        auto in_edges = boost::in_edges(v, ctx->g.g);
+        for (size_t b = 0; b < n_words; b++) {
+            in_words.clear();
+            std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+                in_words.push_back(words[boost::source(e, ctx->g.g)][b]);
+            });
+            words[v][b] = sliced_lut(aig.fun_spec, in_words);
         }
+
+        size_t toggles = 0;
+        for (auto word : sliced_toggles(words[v], n))
+            toggles += __builtin_popcountll(word);
+        weighted_toggles += static_cast<double>(toggles) * aig.num_gates;
     }
 
-    return curr_epsmax;
+    return n > 1 ? weighted_toggles / (n - 1) : 0.0;
 }
 
 size_t EpsMaxEvaluator::gates(const solution_t &s) const {
@@ -112,12 +214,13 @@ size_t EpsMaxEvaluator::gates(const solution_t &s) const {
 }
 
 boost::dynamic_bitset<> EpsMaxEvaluator::evaluate_graph(const solution_t &s,
-                                                     const boost::dynamic_bitset<> &input) const {
+                                                     const boost::dynamic_bitset<> &input,
+                                                     std::map<vertex_d, bool> *cell_values) const {
     // Yosys::dict does not seem to be thread-safe w.r.t. write access?
     // TODO If we had a max of vertex_d we could simply use an array
     std::map<vertex_d, bool> cell_value;
     // We only consider WEIGHTED outputs!
-    std::string output(ctx->weights.size(), '0');
+    std::string output(output_width, '0');
     size_t curr_input = 0; // ugly, but dynamic_bitset has no iterators
 
     for (auto &v : ctx->vertices) {
@@ -143,7 +246,7 @@ boost::dynamic_bitset<> EpsMaxEvaluator::evaluate_graph(const solution_t &s,
             size_t lut_entry = std::stoul(cell_input, nullptr, 2);
             cell_value[v] = lut_specification[lut_entry];
 
-            if (boost::out_degree(v, ctx->g.g) == 0) { // Primary outputs
+            if (ctx->g.g[v].output) { // Primary outputs
                 if (ctx->g.g[v].weight.has_value()) {
                     output[ctx->g.g[v].weight.get()] = cell_value[v] ? '1' : '0';
                 }
@@ -152,6 +255,41 @@ boost::dynamic_bitset<> EpsMaxEvaluator::evaluate_graph(const solution_t &s,
     }
     std::reverse(output.begin(), output.end());
 
+    if (cell_values != nullptr)
+        *cell_values = std::move(cell_value);
+
     return boost::dynamic_bitset<>(output);
 }
+
+sliced_t EpsMaxEvaluator::evaluate_words(const solution_t &s, const size_t block) const {
+    std::vector<uint64_t> node_words(boost::num_vertices(ctx->g.g), 0);
+    sliced_t output(output_width, 0);
+    size_t curr_input = 0;
+
+    for (auto &v : ctx->vertices) {
+        if (boost::in_degree(v, ctx->g.g) == 0) {
+            if (ctx->g.g[v].type == vertex_t::PRIMARY_INPUT)
+                node_words[v] = exhaustive_word(curr_input++, block);
+            else // Constant
+                node_words[v] = ctx->g.g[v].type == vertex_t::CONSTANT_ONE ? ~uint64_t(0) : 0;
+        } else {
+            // The first edge is the least significant input of the LUT
+            std::vector<uint64_t> in_words;
+            auto in_edges = boost::in_edges(v, ctx->g.g);
+            std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+                in_words.push_back(node_words[boost::source(e, ctx->g.g)]);
+            });
+
+            auto &lut_specification =
+                    ctx->luts.at(get_lut_param(ctx->g.g[v].cell))[s.at(ctx->g.g[v])].fun_spec;
+            auto word = sliced_lut(lut_specification, in_words);
+            node_words[v] = word;
+
+            if (ctx->g.g[v].output && ctx->g.g[v].weight.has_value())
+                output[ctx->g.g[v].weight.get()] = word;
+        }
+    }
+
+    return output;
+}
 }
@@ -26,10 +26,14 @@
  */
 
 #include "ErSEvaluator.h"
+#include "variants.h"
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <numeric>
+#include <queue>
+#include <random>
 #include <thread>
 
 namespace yosys_als {
@@ -43,7 +47,8 @@ ErSEvaluator::ErSEvaluator(optimizer_context_t<ErSEvaluator> *ctx) : ctx(ctx) {
 }
 
 void ErSEvaluator::setup(const parameters_t &parameters) {
-    (void) parameters;
+    power_objective = parameters.power_objective;
+    screen = parameters.screen;
 
     // Count reliability normalization factor
     rel_norm = 0.0;
@@ -54,33 +59,184 @@ void ErSEvaluator::setup(const parameters_t &parameters) {
     gates_baseline = gates(ctx->opt->empty_solution().first);
 
     // Set parameters
-    //test_vectors_n = parameters.test_vectors_n;
+    test_vectors_n = parameters.test_vectors_n;
 
     // Create samples and evaluate exact outputs
-    if (ctx->g.num_inputs >= 8 * sizeof(unsigned long)) {
+    if (parameters.distributions != nullptr && !parameters.distributions->empty()) {
+        distribution_sample(*parameters.distributions);
+    } else if (ctx->g.num_inputs >= 8 * sizeof(unsigned long)) {
         test_vectors = simple_sample(test_vectors_n, ctx->g.num_inputs);
     } else {
         size_t total_vectors = 1ul << ctx->g.num_inputs;
         test_vectors = selection_sample(test_vectors_n, total_vectors);
+        exhaustive = test_vectors.size() == total_vectors;
     }
 
-    exact_outputs.reserve(test_vectors.size());
-    for (auto &v : test_vectors)
-        exact_outputs.emplace_back(evaluate_graph(ctx->opt->empty_solution().first, v));
+    // Sampled vectors are drawn from the distribution already, so they weigh the same
+    if (test_weights.empty())
+        test_weights.assign(test_vectors.size(), 1.0);
+    total_weight = std::accumulate(test_weights.begin(), test_weights.end(), 0.0);
+
+    // Golden outputs of a previous run are reused only for the same vectors
+    auto exact_solution = ctx->opt->empty_solution().first;
+    size_t outputs_n = test_vectors.empty() ? 0 : evaluate_graph(exact_solution, test_vectors[0]).size();
+    bool reused = false;
+    if (parameters.golden_path.empty()) {
+        exact_outputs.allocate(outputs_n, test_vectors.size());
+    } else {
+        uint64_t key = parameters.golden_key;
+        for (auto &v : test_vectors) {
+            for (size_t b = 0; b < v.size(); b++)
+                key = (key ^ v[b]) * 1099511628211ull;
+        }
+        reused = exact_outputs.map(parameters.golden_path, outputs_n, test_vectors.size(), key);
+    }
+
+    if (!reused) {
+        for (size_t i = 0; i < test_vectors.size(); i++)
+            exact_outputs.set_column(i, evaluate_graph(exact_solution, test_vectors[i]));
+        exact_outputs.commit();
+    }
+
+    compute_signatures();
+    if (screen)
+        compute_probabilities();
+
+    // Samples are sorted, so toggles are counted and batches are drawn in a fixed random order, not to draw
+    // from rng. Weighted vectors are not a sample, so they are always evaluated in full
+    unit_weights = std::all_of(test_weights.begin(), test_weights.end(), [](double w) { return w == 1.0; });
+    if (unit_weights)
+        batch_size = parameters.batch_size;
+
+    // The test looks at the error after each batch but the last, so each look gets a share of the 5%
+    // significance, and the chance of any wrong early stop stays within it
+    if (batch_size > 0 && batch_size < test_vectors.size())
+        sequential_z = normal_quantile(0.05 / ((test_vectors.size() - 1) / batch_size));
+    vector_order.resize(test_vectors.size());
+    std::iota(vector_order.begin(), vector_order.end(), 0);
+    std::default_random_engine order_rng(test_vectors.size());
+    std::shuffle(vector_order.begin(), vector_order.end(), order_rng);
+
+    // A transition is as likely as both of its vectors
+    pair_weights.assign(vector_order.size(), 0.0);
+    for (size_t k = 1; k < vector_order.size(); k++)
+        pair_weights[k] = test_weights[vector_order[k - 1]] * test_weights[vector_order[k]];
+    total_pair_weight = std::accumulate(pair_weights.begin(), pair_weights.end(), 0.0);
 }
 
 ErSEvaluator::value_t ErSEvaluator::value(const solution_t &s) const {
+    double power_value = power_objective ? power(s) : 0.0;
+
     if (test_vectors.size() < 1000)
         return value_t{1 - circuit_reliability(s),
-                       static_cast<double>(gates(s)) / gates_baseline};
+                       static_cast<double>(gates(s)) / gates_baseline, power_value};
     else
         return value_t{1 - circuit_reliability_smt(s),
-                       static_cast<double>(gates(s)) / gates_baseline};
+                       static_cast<double>(gates(s)) / gates_baseline, power_value};
+}
+
+ErSEvaluator::value_t ErSEvaluator::value(const solution_t &s, const archive_entry_t<ErSEvaluator> &reference,
+                                          bool &partial) const {
+    double gates_value = static_cast<double>(gates(s)) / gates_baseline;
+    partial = false;
+
+    // Screening estimates assume independent signals, so they are kept within the bounds of the signatures,
+    // which hold whatever the LUTs, and give the error when they meet
+    if (screen) {
+        partial = true;
+        std::array<double, 2> bounds;
+        signature_error(s, bounds);
+        auto estimate = probability_estimate(s);
+        double error = bounds[0] == bounds[1] ? 1 - reliability_estimate(1 - bounds[0], test_vectors.size())
+                                              : std::min(std::max(estimate[0], bounds[0]), bounds[1]);
+        double power_value = 0.0;
+        if (power_objective)
+            power_value = activity_estimate_baseline > 0.0 ? estimate[1] / activity_estimate_baseline : 1.0;
+        return value_t{error, gates_value, power_value};
+    }
+
+    double power_value = power_objective ? power(s) : 0.0;
+
+    // Signatures give the error, or bounds that may lie on one side of the reference already. The bounds
+    // are corrected as the error of the reference is
+    std::array<double, 2> bounds;
+    bool exact = signature_error(s, bounds);
+    for (auto &bound : bounds)
+        bound = 1 - reliability_estimate(1 - bound, test_vectors.size());
+    if (exact)
+        return value_t{bounds[0], gates_value, power_value};
+    if (bounds[0] > reference.second[0] || bounds[1] < reference.second[0]) {
+        partial = true;
+        return value_t{bounds[bounds[0] > reference.second[0] ? 0 : 1], gates_value, power_value};
+    }
+
+    if (batch_size == 0 || batch_size >= test_vectors.size()) {
+        double r_s = test_vectors.size() < 1000 ? circuit_reliability(s) : circuit_reliability_smt(s);
+        return value_t{1 - r_s, gates_value, power_value};
+    }
+
+    // Each prefix of the random order is a random sample, so the test can stop after any batch, with the
+    // same estimate of the error as the whole sample would give, and its bounds corrected as the error of
+    // the reference is. The estimate only decides the comparison, so it is partial
+    size_t errors = 0;
+    for (size_t begin = 0; begin < test_vectors.size(); begin += batch_size) {
+        size_t end = std::min(begin + batch_size, test_vectors.size());
+        errors += count_errors(s, begin, end);
+
+        auto bounds = wilson_bounds(errors, end, sequential_z);
+        for (auto &bound : bounds)
+            bound = 1 - reliability_estimate(1 - bound, test_vectors.size());
+        if (end < test_vectors.size() && (bounds[0] > reference.second[0] || bounds[1] < reference.second[0])) {
+            double r_s = 1.0 - static_cast<double>(errors) / end;
+            partial = true;
+            return value_t{1 - reliability_estimate(r_s, end), gates_value, power_value};
+        }
+    }
+
+    double r_s = 1.0 - static_cast<double>(errors) / test_vectors.size();
+    return value_t{1 - reliability_estimate(r_s, test_vectors.size()), gates_value, power_value};
 }
 
-ErSEvaluator::value_t ErSEvaluator::empty_solution_value(const solution_t &s) {
+ErSEvaluator::value_t ErSEvaluator::empty_solution_value(const solution_t &s) const {
     (void) s;
-    return {0, 1};
+    return {0, 1, power_objective ? 1.0 : 0.0};
+}
+
+fidelity_t ErSEvaluator::fidelity(const solution_t &s) const {
+    double exact = 0.0;
+    size_t errors = 0;
+    for (size_t i = 0; i < test_vectors.size(); i++) {
+        if (exact_outputs.matches(i, evaluate_graph(s, test_vectors[i])))
+            exact += test_weights[i];
+        else
+            errors++;
+    }
+
+    fidelity_t f;
+    f.samples = test_vectors.size();
+    f.exhaustive = exhaustive;
+
+    // Only exhaustive vectors have weights other than one
+    if (f.exhaustive) {
+        double e_s = 1.0 - exact / total_weight;
+        f.bounds = {{e_s, e_s}};
+    } else {
+        f.bounds = wilson_bounds(errors, f.samples);
+    }
+
+    return f;
+}
+
+double ErSEvaluator::power(const solution_t &s) const {
+    // The exact circuit is only simulated once power is needed, as an objective or for the results
+    if (activity_baseline < 0.0)
+        activity_baseline = switching_activity(ctx->opt->empty_solution().first);
+
+    // A circuit that never toggles only has equally quiet variants
+    if (activity_baseline == 0.0)
+        return 1.0;
+
+    return switching_activity(s) / activity_baseline;
 }
 
 bool ErSEvaluator::dominates(const archive_entry_t<ErSEvaluator> &s1,
@@ -89,8 +245,11 @@ bool ErSEvaluator::dominates(const archive_entry_t<ErSEvaluator> &s1,
     double arel2 = fabs(arel_bias - s2.second[0]);
     double gate1 = s1.second[1];
     double gate2 = s2.second[1];
+    double power1 = s1.second[2];
+    double power2 = s2.second[2];
 
-    return (arel1 <= arel2 && gate1 < gate2) || (arel1 < arel2 && gate1 <= gate2);
+    return arel1 <= arel2 && gate1 <= gate2 && power1 <= power2 &&
+           (arel1 < arel2 || gate1 < gate2 || power1 < power2);
 }
 
 /*
@@ -137,19 +296,380 @@ std::vector<boost::dynamic_bitset<>> ErSEvaluator::simple_sample(unsigned long n
     return sample;
 }
 
-double ErSEvaluator::circuit_reliability(const solution_t &s) const {
-    size_t exact = 0;
+void ErSEvaluator::distribution_sample(const distributions_t &distributions) {
+    // Inputs are numbered in the order in which they are evaluated
+    Yosys::dict<Yosys::SigBit, size_t> position;
+    for (auto &v : ctx->vertices) {
+        if (ctx->g.g[v].type == vertex_t::PRIMARY_INPUT) {
+            size_t next = position.size();
+            position[ctx->g.g[v].bit] = next;
+        }
+    }
+
+    // Each factor draws some inputs jointly: the bits of a signal with a histogram, or a single bit
+    struct factor_t {
+        std::vector<size_t> positions;
+        std::vector<std::pair<uint64_t, double>> values;
+    };
+    std::vector<factor_t> factors;
+    std::vector<bool> covered(ctx->g.num_inputs, false);
+    std::vector<double> probability(ctx->g.num_inputs, 0.5);
+
+    for (auto &d : distributions) {
+        auto signal = ctx->sigmap(d.signal);
+        if (d.histogram.empty()) {
+            for (auto &bit : signal) {
+                auto p = position.find(bit);
+                if (p != position.end())
+                    probability[p->second] = d.probability;
+            }
+            continue;
+        }
+
+        // Values are projected on the bits that are inputs of the circuit
+        factor_t factor;
+        std::vector<int> offsets;
+        for (int i = 0; i < signal.size(); i++) {
+            auto p = position.find(signal[i]);
+            if (p != position.end() && !covered[p->second]) {
+                covered[p->second] = true;
+                factor.positions.push_back(p->second);
+                offsets.push_back(i);
+            }
+        }
+        if (factor.positions.empty())
+            continue;
+
+        std::map<uint64_t, double> projected;
+        double total = 0.0;
+        for (auto &h : d.histogram) {
+            uint64_t value = 0;
+            for (size_t b = 0; b < offsets.size(); b++) {
+                if ((h.first >> offsets[b]) & 1u)
+                    value |= uint64_t(1) << b;
+            }
+            projected[value] += h.second;
+            total += h.second;
+        }
+        for (auto &p : projected)
+            factor.values.emplace_back(p.first, p.second / total);
+        factors.push_back(factor);
+    }
+
+    for (size_t i = 0; i < ctx->g.num_inputs; i++) {
+        if (covered[i])
+            continue;
+
+        factor_t factor;
+        factor.positions.push_back(i);
+        if (probability[i] < 1.0)
+            factor.values.emplace_back(0, 1.0 - probability[i]);
+        if (probability[i] > 0.0)
+            factor.values.emplace_back(1, probability[i]);
+        factors.push_back(factor);
+    }
+
+    auto assign = [](boost::dynamic_bitset<> &vector, const factor_t &factor, uint64_t value) {
+        for (size_t b = 0; b < factor.positions.size(); b++)
+            vector[factor.positions[b]] = (value >> b) & 1u;
+    };
+
+    // Distributions with a small support are enumerated, each vector weighted by its probability
+    size_t support = 1;
+    for (auto &factor : factors) {
+        if (support > test_vectors_n / factor.values.size()) {
+            support = 0;
+            break;
+        }
+        support *= factor.values.size();
+    }
+
+    if (support > 0) {
+        std::vector<size_t> index(factors.size(), 0);
+        for (size_t k = 0; k < support; k++) {
+            boost::dynamic_bitset<> vector(ctx->g.num_inputs);
+            double weight = 1.0;
+            for (size_t f = 0; f < factors.size(); f++) {
+                assign(vector, factors[f], factors[f].values[index[f]].first);
+                weight *= factors[f].values[index[f]].second;
+            }
+            test_vectors.push_back(vector);
+            test_weights.push_back(weight);
+
+            for (size_t f = 0; f < factors.size() && ++index[f] == factors[f].values.size(); f++)
+                index[f] = 0;
+        }
+
+        exhaustive = true;
+        return;
+    }
+
+    // Otherwise each factor is stratified on its own, i.e. a Latin hypercube, so that every value
+    // appears in proportion to its probability, and the strata of the factors are matched at random
+    std::uniform_real_distribution<double> U(0.0, 1.0);
+    test_vectors.assign(test_vectors_n, boost::dynamic_bitset<>(ctx->g.num_inputs));
+    std::vector<size_t> order(test_vectors_n);
+
+    for (auto &factor : factors) {
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), rng);
+
+        size_t j = 0;
+        double cumulative = factor.values[0].second;
+        for (size_t i = 0; i < test_vectors_n; i++) {
+            double u = (i + U(rng)) / test_vectors_n;
+            while (u > cumulative && j + 1 < factor.values.size())
+                cumulative += factor.values[++j].second;
+            assign(test_vectors[order[i]], factor, factor.values[j].first);
+        }
+    }
+}
+
+void ErSEvaluator::compute_signatures() {
+    size_t n_words = (test_vectors.size() + 63) / 64;
+    size_t n_vertices = boost::num_vertices(ctx->g.g);
+    uint64_t last_mask = test_vectors.size() % 64 == 0 ? ~uint64_t(0) : (uint64_t(1) << (test_vectors.size() % 64)) - 1;
+
+    // Words of the exact circuit, and of the vertices that change when a LUT is flipped
+    std::vector<std::vector<uint64_t>> exact_words(n_vertices, std::vector<uint64_t>(n_words, 0));
+    std::vector<std::vector<uint64_t>> flipped_words(n_vertices);
+    auto words_of = [&](vertex_d v) -> const std::vector<uint64_t> & {
+        return flipped_words[v].empty() ? exact_words[v] : flipped_words[v];
+    };
+    auto evaluate_lut = [&](vertex_d v, const boost::dynamic_bitset<> &fun_spec) {
+        std::vector<uint64_t> words(n_words);
+        std::vector<uint64_t> in_words;
+        auto in_edges = boost::in_edges(v, ctx->g.g);
+        for (size_t b = 0; b < n_words; b++) {
+            in_words.clear();
+            std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+                in_words.push_back(words_of(boost::source(e, ctx->g.g))[b]);
+            });
+            words[b] = sliced_lut(fun_spec, in_words);
+        }
+        return words;
+    };
+
+    std::vector<size_t> position(n_vertices, 0);
+    size_t curr_input = 0;
+    for (size_t k = 0; k < ctx->vertices.size(); k++) {
+        auto v = ctx->vertices[k];
+        position[v] = k;
+        if (boost::in_degree(v, ctx->g.g) == 0) {
+            if (ctx->g.g[v].type == vertex_t::PRIMARY_INPUT) {
+                for (size_t i = 0; i < test_vectors.size(); i++) {
+                    if (test_vectors[i][curr_input])
+                        exact_words[v][i / 64] |= uint64_t(1) << (i % 64);
+                }
+                curr_input++;
+            } else if (ctx->g.g[v].type == vertex_t::CONSTANT_ONE) {
+                exact_words[v].assign(n_words, ~uint64_t(0));
+            }
+        } else {
+            exact_words[v] = evaluate_lut(v, ctx->luts.at(get_lut_param(ctx->g.g[v].cell))[0].fun_spec);
+        }
+    }
+
+    for (auto &v : ctx->vertices) {
+        auto &vertex = ctx->g.g[v];
+        if (vertex.type != vertex_t::CELL)
+            continue;
+
+        auto &levels = ctx->luts.at(get_lut_param(vertex.cell));
+        auto &signature = signatures[vertex.name];
+        signature.observable.assign(n_words, 0);
+
+        // LUTs without inputs are evaluated as constants, whatever their level
+        for (auto &aig : levels) {
+            std::vector<uint64_t> flip(n_words, 0);
+            if (boost::in_degree(v, ctx->g.g) > 0) {
+                flip = evaluate_lut(v, aig.fun_spec);
+                for (size_t b = 0; b < n_words; b++)
+                    flip[b] ^= exact_words[v][b];
+                if (n_words > 0)
+                    flip.back() &= last_mask;
+            }
+            signature.flips.push_back(flip);
+        }
 
+        // The flip is propagated in topological order, only through the vertices that change
+        std::priority_queue<std::pair<size_t, vertex_d>, std::vector<std::pair<size_t, vertex_d>>,
+                            std::greater<std::pair<size_t, vertex_d>>> queue;
+        std::vector<vertex_d> changed;
+        auto enqueue_fanout = [&](vertex_d u) {
+            auto out_edges = boost::out_edges(u, ctx->g.g);
+            std::for_each(out_edges.first, out_edges.second, [&](const edge_d &e) {
+                auto t = boost::target(e, ctx->g.g);
+                if (flipped_words[t].empty())
+                    queue.emplace(position[t], t);
+            });
+        };
+
+        flipped_words[v] = exact_words[v];
+        for (auto &word : flipped_words[v])
+            word = ~word;
+        changed.push_back(v);
+        if (ctx->g.g[v].output)
+            signature.observable.assign(n_words, ~uint64_t(0));
+        enqueue_fanout(v);
+
+        while (!queue.empty()) {
+            // A vertex is queued once for each changed input, and all of them come first
+            auto u = queue.top().second;
+            while (!queue.empty() && queue.top().second == u)
+                queue.pop();
+
+            signature.reached.push_back(ctx->g.g[u].name);
+            auto words = evaluate_lut(u, ctx->luts.at(get_lut_param(ctx->g.g[u].cell))[0].fun_spec);
+            if (words == exact_words[u])
+                continue;
+
+            if (ctx->g.g[u].output) {
+                for (size_t b = 0; b < n_words; b++)
+                    signature.observable[b] |= words[b] ^ exact_words[u][b];
+            }
+            flipped_words[u] = std::move(words);
+            changed.push_back(u);
+            enqueue_fanout(u);
+        }
+
+        for (auto &u : changed)
+            flipped_words[u].clear();
+        std::sort(signature.reached.begin(), signature.reached.end());
+    }
+
+    // Settle the dict, so that lookups while evaluating do not rehash it
+    signatures.count(Yosys::IdString());
+}
+
+bool ErSEvaluator::signature_error(const solution_t &s, std::array<double, 2> &bounds) const {
+    size_t n_words = (test_vectors.size() + 63) / 64;
+    std::vector<std::pair<Yosys::IdString, size_t>> deviating;
+    for (auto &v : s) {
+        if (v.second != 0)
+            deviating.emplace_back(v.first.name, v.second);
+    }
+
+    // Where no LUT flips, the circuit is exact; where a single one flips, the error is its observability,
+    // unless the flip reaches another LUT that differs from the exact one, whose inputs are then not exact
+    std::vector<uint64_t> flipped(n_words, 0);
+    std::vector<uint64_t> unknown(n_words, 0);
+    std::vector<uint64_t> observed(n_words, 0);
+    for (auto &d : deviating) {
+        auto &signature = signatures.at(d.first);
+        auto &flip = signature.flips[d.second];
+        bool reaches = false;
+        for (auto &e : deviating)
+            reaches = reaches || std::binary_search(signature.reached.begin(), signature.reached.end(), e.first);
+
+        for (size_t b = 0; b < n_words; b++) {
+            unknown[b] |= (flipped[b] & flip[b]) | (reaches ? flip[b] : 0);
+            observed[b] |= flip[b] & signature.observable[b];
+            flipped[b] |= flip[b];
+        }
+    }
+
+    double errors = 0.0;
+    double unknown_weight = 0.0;
+    for (size_t b = 0; b < n_words; b++) {
+        for (uint64_t word = observed[b] & ~unknown[b]; word != 0; word &= word - 1)
+            errors += test_weights[64 * b + __builtin_ctzll(word)];
+        for (uint64_t word = unknown[b]; word != 0; word &= word - 1)
+            unknown_weight += test_weights[64 * b + __builtin_ctzll(word)];
+    }
+
+    bounds = {{errors / total_weight, (errors + unknown_weight) / total_weight}};
+    return deviating.size() <= 1;
+}
+
+void ErSEvaluator::compute_probabilities() {
+    // Inputs are as likely to be one as in the test vectors, whatever their distribution
+    input_probability.assign(ctx->g.num_inputs, 0.0);
     for (size_t i = 0; i < test_vectors.size(); i++) {
-        if (evaluate_graph(s, test_vectors[i]) == exact_outputs[i]) {
-            exact++;
+        for (size_t b = 0; b < ctx->g.num_inputs; b++) {
+            if (test_vectors[i][b])
+                input_probability[b] += test_weights[i] / total_weight;
+        }
+    }
+
+    // Exact LUTs with exact inputs keep the probabilities of the exact circuit
+    std::vector<double> probabilities(boost::num_vertices(ctx->g.g), 0.0);
+    exact_probability.clear();
+    activity_estimate_baseline = probability_estimate(ctx->opt->empty_solution().first, &probabilities)[1];
+    exact_probability = std::move(probabilities);
+}
+
+std::array<double, 2> ErSEvaluator::probability_estimate(const solution_t &s,
+                                                         std::vector<double> *probabilities) const {
+    // Joint probabilities of the exact and approximate value of each vertex, indexed by exact * 2 + approximate.
+    // The inputs of a LUT are taken as independent, so only reconvergent fanout is not accounted for
+    std::vector<std::array<double, 4>> joint(boost::num_vertices(ctx->g.g));
+    double correct = 1.0;
+    double toggles = 0.0;
+    size_t curr_input = 0;
+
+    for (auto &v : ctx->vertices) {
+        auto &vertex = ctx->g.g[v];
+        if (boost::in_degree(v, ctx->g.g) == 0) {
+            double p = 0.0;
+            if (vertex.type == vertex_t::PRIMARY_INPUT)
+                p = input_probability[curr_input++];
+            else if (vertex.type == vertex_t::CONSTANT_ONE)
+                p = 1.0;
+            joint[v] = {{1.0 - p, 0.0, 0.0, p}};
+            continue;
         }
+
+        auto &levels = ctx->luts.at(get_lut_param(vertex.cell));
+        auto level = s.at(vertex);
+        auto in_edges = boost::in_edges(v, ctx->g.g);
+        bool erroneous = level != 0 || exact_probability.empty();
+        std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+            auto &in = joint[boost::source(e, ctx->g.g)];
+            erroneous = erroneous || in[1] > 0.0 || in[2] > 0.0;
+        });
+
+        if (!erroneous) {
+            joint[v] = {{1.0 - exact_probability[v], 0.0, 0.0, exact_probability[v]}};
+        } else {
+            // Combinations of the inputs are expanded one input at a time, skipping the impossible ones
+            std::vector<std::pair<std::array<size_t, 2>, double>> combinations{{{{0, 0}}, 1.0}};
+            std::vector<std::pair<std::array<size_t, 2>, double>> expanded;
+            size_t j = 0;
+            std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+                auto &in = joint[boost::source(e, ctx->g.g)];
+                expanded.clear();
+                for (auto &c : combinations) {
+                    for (size_t state = 0; state < 4; state++) {
+                        if (in[state] > 0.0)
+                            expanded.push_back({{{c.first[0] | (state >> 1) << j, c.first[1] | (state & 1u) << j}},
+                                                c.second * in[state]});
+                    }
+                }
+                combinations.swap(expanded);
+                j++;
+            });
+
+            joint[v] = {{0.0, 0.0, 0.0, 0.0}};
+            for (auto &c : combinations)
+                joint[v][levels[0].fun_spec[c.first[0]] * 2 + levels[level].fun_spec[c.first[1]]] += c.second;
+        }
+
+        // Toggles of independent consecutive vectors, weighted by gates as in the simulation
+        double p = joint[v][1] + joint[v][3];
+        toggles += 2.0 * p * (1.0 - p) * levels[level].num_gates;
+        if (probabilities != nullptr)
+            (*probabilities)[v] = p;
+
+        if (ctx->g.g[v].output)
+            correct *= joint[v][0] + joint[v][3];
     }
 
-    double r_s = static_cast<double>(exact) / test_vectors.size();
-    size_t n_s = test_vectors.size();
+    return {{1.0 - correct, toggles}};
+}
 
-    if (log2(10.0 * n_s) < ctx->g.num_inputs) {
+double ErSEvaluator::reliability_estimate(double r_s, size_t n_s) const {
+    if (!exhaustive && log2(10.0 * n_s) < ctx->g.num_inputs) {
         double estimated_rel = r_s + (4.5 / n_s) * (1 + sqrt(1 + (4.0 / 9.0) * n_s * r_s * (1 - r_s)));
         if (estimated_rel > 1.0)
             return r_s;
@@ -160,8 +680,53 @@ double ErSEvaluator::circuit_reliability(const solution_t &s) const {
     }
 }
 
+size_t ErSEvaluator::count_errors(const solution_t &s, size_t begin, size_t end) const {
+    // Small batches are not worth the threads
+    if (processor_count == 1 || end - begin < 64 * processor_count) {
+        size_t errors = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (!exact_outputs.matches(vector_order[i], evaluate_graph(s, test_vectors[vector_order[i]])))
+                errors++;
+        }
+        return errors;
+    }
+
+    std::vector<size_t> errors(processor_count, 0);
+    std::vector<std::thread> threads;
+    size_t slice = (end - begin) / processor_count + 1;
+
+    for (size_t j = 0; j < processor_count; j++) {
+        size_t start = std::min(begin + j * slice, end);
+        size_t stop = std::min(start + slice, end);
+
+        threads.emplace_back([this, &s, &errors, start, stop, j]() {
+            for (size_t i = start; i < stop; i++) {
+                if (!exact_outputs.matches(vector_order[i], evaluate_graph(s, test_vectors[vector_order[i]])))
+                    errors[j]++;
+            }
+        });
+    }
+
+    for (auto &t : threads)
+        t.join();
+
+    return std::accumulate(errors.begin(), errors.end(), (size_t) 0);
+}
+
+double ErSEvaluator::circuit_reliability(const solution_t &s) const {
+    double exact = 0.0;
+
+    for (size_t i = 0; i < test_vectors.size(); i++) {
+        if (exact_outputs.matches(i, evaluate_graph(s, test_vectors[i]))) {
+            exact += test_weights[i];
+        }
+    }
+
+    return reliability_estimate(exact / total_weight, test_vectors.size());
+}
+
 double ErSEvaluator::circuit_reliability_smt(const solution_t &s) const {
-    std::vector<size_t> exact(processor_count, 0);
+    std::vector<double> exact(processor_count, 0.0);
     std::vector<std::thread> threads;
     size_t slice = test_vectors.size() / processor_count + 1;
 
@@ -171,8 +736,8 @@ double ErSEvaluator::circuit_reliability_smt(const solution_t &s) const {
 
         threads.emplace_back([this, &s, &exact, start, end, j]() {
             for (size_t i = start; i < end; i++) {
-                if (evaluate_graph(s, test_vectors[i]) == exact_outputs[i]) {
-                    exact[j]++;
+                if (exact_outputs.matches(i, evaluate_graph(s, test_vectors[i]))) {
+                    exact[j] += test_weights[i];
                 }
             }
         });
@@ -181,19 +746,61 @@ double ErSEvaluator::circuit_reliability_smt(const solution_t &s) const {
     for (auto &t : threads)
         t.join();
 
-    size_t exact_tot = std::accumulate(exact.begin(), exact.end(), (size_t) 0);
-    double r_s = static_cast<double>(exact_tot) / test_vectors.size();
-    size_t n_s = test_vectors.size();
+    double exact_tot = std::accumulate(exact.begin(), exact.end(), 0.0);
+    return reliability_estimate(exact_tot / total_weight, test_vectors.size());
+}
 
-    if (log2(10.0 * n_s) < ctx->g.num_inputs) {
-        double estimated_rel = r_s + (4.5 / n_s) * (1 + sqrt(1 + (4.0 / 9.0) * n_s * r_s * (1 - r_s)));
-        if (estimated_rel > 1.0)
-            return r_s;
-        else
-            return estimated_rel;
-    } else {
-        return r_s;
+double ErSEvaluator::switching_activity(const solution_t &s) const {
+    // Vectors are packed in the random order and simulated 64 at a time, so that a toggle is a bit that
+    // differs from the one before it
+    size_t n = vector_order.size();
+    size_t n_words = (n + 63) / 64;
+    std::vector<std::vector<uint64_t>> words(boost::num_vertices(ctx->g.g));
+    std::vector<uint64_t> in_words;
+    double weighted_toggles = 0.0;
+    size_t curr_input = 0;
+
+    for (auto &v : ctx->vertices) {
+        auto &vertex = ctx->g.g[v];
+        words[v].assign(n_words, 0);
+        if (boost::in_degree(v, ctx->g.g) == 0) {
+            if (vertex.type == vertex_t::PRIMARY_INPUT) {
+                for (size_t k = 0; k < n; k++) {
+                    if (test_vectors[vector_order[k]][curr_input])
+                        words[v][k / 64] |= uint64_t(1) << (k % 64);
+                }
+                curr_input++;
+            } else if (vertex.type == vertex_t::CONSTANT_ONE) {
+                words[v].assign(n_words, ~uint64_t(0));
+            }
+            continue;
+        }
+
+        // The first edge is the least significant input of the LUT
+        auto &aig = ctx->luts.at(get_lut_param(vertex.cell))[s.at(vertex)];
+        auto in_edges = boost::in_edges(v, ctx->g.g);
+        for (size_t b = 0; b < n_words; b++) {
+            in_words.clear();
+            std::for_each(in_edges.first, in_edges.second, [&](const edge_d &e) {
+                in_words.push_back(words[boost::source(e, ctx->g.g)][b]);
+            });
+            words[v][b] = sliced_lut(aig.fun_spec, in_words);
+        }
+
+        auto toggles = sliced_toggles(words[v], n);
+        double toggle_weight = 0.0;
+        for (size_t b = 0; b < n_words; b++) {
+            if (unit_weights) {
+                toggle_weight += __builtin_popcountll(toggles[b]);
+            } else {
+                for (uint64_t word = toggles[b]; word != 0; word &= word - 1)
+                    toggle_weight += pair_weights[64 * b + __builtin_ctzll(word)];
+            }
+        }
+        weighted_toggles += toggle_weight * aig.num_gates;
     }
+
+    return total_pair_weight > 0.0 ? weighted_toggles / total_pair_weight : 0.0;
 }
 
 size_t ErSEvaluator::gates(const solution_t &s) const {
@@ -206,7 +813,8 @@ size_t ErSEvaluator::gates(const solution_t &s) const {
 }
 
 boost::dynamic_bitset<> ErSEvaluator::evaluate_graph(const solution_t &s,
-                                                     const boost::dynamic_bitset<> &input) const {
+                                                     const boost::dynamic_bitset<> &input,
+                                                     std::map<vertex_d, bool> *cell_values) const {
     // Yosys::dict does not seem to be thread-safe w.r.t. write access?
     // TODO If we had a max of vertex_d we could simply use an array
     std::map<vertex_d, bool> cell_value;
@@ -236,7 +844,7 @@ boost::dynamic_bitset<> ErSEvaluator::evaluate_graph(const solution_t &s,
             size_t lut_entry = std::stoul(cell_input, nullptr, 2);
             cell_value[v] = lut_specification[lut_entry];
 
-            if (boost::out_degree(v, ctx->g.g) == 0) { // Primary outputs
+            if (ctx->g.g[v].output) { // Primary outputs
                 // maybe it's faster to append directly to a bitset? we should profile
                 output += cell_value[v] ? "1" : "0";
             }
@@ -244,6 +852,9 @@ boost::dynamic_bitset<> ErSEvaluator::evaluate_graph(const solution_t &s,
     }
     std::reverse(output.begin(), output.end());
 
+    if (cell_values != nullptr)
+        *cell_values = std::move(cell_value);
+
     return boost::dynamic_bitset<>(output);
 }
 }
@@ -0,0 +1,220 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Packed matrix of golden outputs for Yosys ALS module
+ */
+
+#include "OutputMatrix.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yosys_als {
+
+/*
+ * File format
+ */
+
+/// File header, followed by the rows of the matrix
+struct OutputMatrix::header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t complete;
+    uint64_t key;
+    uint64_t outputs;
+    uint64_t vectors;
+};
+
+static const char matrix_magic[8] = {'A', 'L', 'S', 'G', 'O', 'L', 'D', '\0'};
+static constexpr uint32_t matrix_version = 1;
+
+/*
+ * Exposed methods
+ */
+
+OutputMatrix::~OutputMatrix() {
+    release();
+}
+
+void OutputMatrix::allocate(const size_t outputs, const size_t vectors) {
+    release();
+
+    n_outputs = outputs;
+    n_vectors = vectors;
+    row_words = (vectors + 63) / 64;
+    memory.assign(n_outputs * row_words, 0);
+    words = memory.data();
+}
+
+bool OutputMatrix::map(const std::string &path, const size_t outputs, const size_t vectors, const uint64_t key) {
+    release();
+
+    n_outputs = outputs;
+    n_vectors = vectors;
+    row_words = (vectors + 63) / 64;
+    data_size = sizeof(header_t) + n_outputs * row_words * sizeof(uint64_t);
+
+    // Only a complete matrix for the same circuit and vectors is reused, and only read
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        header_t header;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == data_size &&
+            pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+            std::memcmp(header.magic, matrix_magic, sizeof(matrix_magic)) == 0 &&
+            header.version == matrix_version && header.complete != 0 && header.key == key &&
+            header.outputs == n_outputs && header.vectors == n_vectors) {
+            data = mmap(nullptr, data_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED) {
+                data = nullptr;
+                throw std::runtime_error("Cannot map golden outputs " + path + ".");
+            }
+
+            // Every evaluation reads the whole matrix, so it is paged in ahead
+            madvise(data, data_size, MADV_WILLNEED);
+            words = reinterpret_cast<uint64_t *>(static_cast<char *>(data) + sizeof(header_t));
+            return true;
+        }
+        close(fd);
+    }
+
+    // Other runs may have mapped the file, so it is replaced by a new one rather than truncated
+    target_path = path;
+    tmp_path = path + ".tmp." + std::to_string(getpid());
+    fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Cannot create golden outputs " + tmp_path + ".");
+    if (ftruncate(fd, data_size) != 0) {
+        close(fd);
+        release();
+        throw std::runtime_error("Cannot resize golden outputs " + tmp_path + ".");
+    }
+
+    data = mmap(nullptr, data_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        data = nullptr;
+        release();
+        throw std::runtime_error("Cannot map golden outputs " + tmp_path + ".");
+    }
+
+    header_t header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, matrix_magic, sizeof(matrix_magic));
+    header.version = matrix_version;
+    header.key = key;
+    header.outputs = n_outputs;
+    header.vectors = n_vectors;
+    std::memcpy(data, &header, sizeof(header));
+
+    words = reinterpret_cast<uint64_t *>(static_cast<char *>(data) + sizeof(header_t));
+    return false;
+}
+
+void OutputMatrix::commit() {
+    if (data == nullptr || tmp_path.empty())
+        return;
+
+    // The rows reach the file before the matrix is marked as complete, and both before it is visible
+    msync(data, data_size, MS_SYNC);
+    static_cast<header_t *>(data)->complete = 1;
+    msync(data, data_size, MS_SYNC);
+
+    // The mapping stays valid after the rename, so a failure only loses the file for later runs
+    if (rename(tmp_path.c_str(), target_path.c_str()) != 0)
+        unlink(tmp_path.c_str());
+    tmp_path.clear();
+}
+
+size_t OutputMatrix::outputs() const {
+    return n_outputs;
+}
+
+size_t OutputMatrix::vectors() const {
+    return n_vectors;
+}
+
+void OutputMatrix::set_column(const size_t vector, const boost::dynamic_bitset<> &outputs) {
+    uint64_t mask = uint64_t(1) << (vector % 64);
+
+    for (size_t o = 0; o < n_outputs; o++) {
+        auto &word = words[o * row_words + vector / 64];
+        word = outputs[o] ? word | mask : word & ~mask;
+    }
+}
+
+void OutputMatrix::set_word(const size_t output, const size_t word, const uint64_t value) {
+    words[output * row_words + word] = value;
+}
+
+boost::dynamic_bitset<> OutputMatrix::column(const size_t vector) const {
+    boost::dynamic_bitset<> outputs(n_outputs);
+
+    for (size_t o = 0; o < n_outputs; o++)
+        outputs[o] = (words[o * row_words + vector / 64] >> (vector % 64)) & 1u;
+
+    return outputs;
+}
+
+bool OutputMatrix::matches(const size_t vector, const boost::dynamic_bitset<> &outputs) const {
+    if (outputs.size() != n_outputs)
+        return false;
+
+    for (size_t o = 0; o < n_outputs; o++) {
+        if (((words[o * row_words + vector / 64] >> (vector % 64)) & 1u) != outputs[o])
+            return false;
+    }
+
+    return true;
+}
+
+const uint64_t *OutputMatrix::row(const size_t output) const {
+    return words + output * row_words;
+}
+
+/*
+ * Private methods
+ */
+
+void OutputMatrix::release() {
+    if (data != nullptr)
+        munmap(data, data_size);
+
+    // A matrix that was never committed is not worth keeping
+    if (!tmp_path.empty())
+        unlink(tmp_path.c_str());
+    tmp_path.clear();
+    target_path.clear();
+
+    data = nullptr;
+    data_size = 0;
+    memory.clear();
+    memory.shrink_to_fit();
+    words = nullptr;
+}
+}
@@ -0,0 +1,200 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Bit-parallel simulation of gate-level modules for Yosys ALS module
+ */
+
+#include "Simulator.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/sigtools.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <functional>
+#include <stdexcept>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/*
+ * Exposed methods
+ */
+
+Simulator::Simulator(Module *module) {
+    SigMap sigmap(module);
+    dict<SigBit, size_t> nodes;
+    dict<SigBit, Cell *> drivers;
+
+    // Nodes 0 and 1 are the constants
+    num_nodes = 2;
+
+    for (auto &port : module->ports) {
+        auto wire = module->wire(port);
+        for (int i = 0; i < wire->width; i++) {
+            if (wire->port_input) {
+                auto bit = sigmap(SigBit(wire, i));
+                if (!nodes.count(bit))
+                    nodes[bit] = num_nodes++;
+                input_bits.emplace_back(port, i);
+                input_nodes.push_back(nodes.at(bit));
+            }
+            if (wire->port_output)
+                output_bits.emplace_back(port, i);
+        }
+    }
+
+    for (auto cell : module->cells()) {
+        if (cell->type != "$_BUF_" && cell->type != "$_NOT_" && cell->type != "$_AND_" && cell->type != "$_OR_" &&
+            cell->type != "$_XOR_" && cell->type != "$lut")
+            throw std::runtime_error("Cell " + cell->name.str() + " of type " + cell->type.str() +
+                                     " cannot be simulated.");
+
+        for (auto bit : sigmap(cell->getPort("\\Y")))
+            drivers[bit] = cell;
+    }
+
+    // Cells are compiled depth-first from the outputs, so that operations are in topological order
+    pool<Cell *> visiting;
+    std::function<void(Cell *)> compile;
+    std::function<size_t(const SigBit &)> node_of = [&](const SigBit &b) -> size_t {
+        auto bit = sigmap(b);
+        if (bit.wire == nullptr)
+            return bit.data == State::S1 ? 1 : 0;
+
+        auto node = nodes.find(bit);
+        if (node != nodes.end())
+            return node->second;
+
+        auto driver = drivers.find(bit);
+        if (driver == drivers.end())
+            return 0;
+
+        compile(driver->second);
+        return nodes.at(bit);
+    };
+
+    compile = [&](Cell *cell) {
+        if (visiting.count(cell))
+            throw std::runtime_error("Combinational loop through cell " + cell->name.str() + ".");
+        visiting.insert(cell);
+
+        op_t op;
+        if (cell->type == "$_BUF_")
+            op.type = op_t::BUF;
+        else if (cell->type == "$_NOT_")
+            op.type = op_t::NOT;
+        else if (cell->type == "$_AND_")
+            op.type = op_t::AND;
+        else if (cell->type == "$_OR_")
+            op.type = op_t::OR;
+        else if (cell->type == "$_XOR_")
+            op.type = op_t::XOR;
+        else
+            op.type = op_t::LUT;
+
+        for (auto bit : cell->getPort("\\A"))
+            op.in.push_back(node_of(bit));
+        if (cell->hasPort("\\B")) {
+            for (auto bit : cell->getPort("\\B"))
+                op.in.push_back(node_of(bit));
+        }
+
+        if (op.type == op_t::LUT) {
+            auto &lut = cell->getParam("\\LUT");
+            op.table.resize(1ul << op.in.size(), false);
+            for (size_t i = 0; i < op.table.size() && i < lut.bits.size(); i++)
+                op.table[i] = lut.bits[i] == State::S1;
+        }
+
+        op.out = num_nodes++;
+        nodes[sigmap(cell->getPort("\\Y")).as_bit()] = op.out;
+        ops.push_back(std::move(op));
+        visiting.erase(cell);
+    };
+
+    for (auto &output : output_bits)
+        output_nodes.push_back(node_of(SigBit(module->wire(output.first), output.second)));
+}
+
+const std::vector<port_bit_t> &Simulator::inputs() const {
+    return input_bits;
+}
+
+const std::vector<port_bit_t> &Simulator::outputs() const {
+    return output_bits;
+}
+
+std::vector<uint64_t> Simulator::simulate(const std::vector<uint64_t> &input_words) const {
+    std::vector<uint64_t> values(num_nodes, 0);
+    std::vector<uint64_t> table;
+    values[1] = ~uint64_t(0);
+
+    for (size_t i = 0; i < input_nodes.size(); i++)
+        values[input_nodes[i]] = input_words[i];
+
+    for (auto &op : ops) {
+        switch (op.type) {
+            case op_t::BUF:
+                values[op.out] = values[op.in[0]];
+                break;
+            case op_t::NOT:
+                values[op.out] = ~values[op.in[0]];
+                break;
+            case op_t::AND:
+                values[op.out] = values[op.in[0]] & values[op.in[1]];
+                break;
+            case op_t::OR:
+                values[op.out] = values[op.in[0]] | values[op.in[1]];
+                break;
+            case op_t::XOR:
+                values[op.out] = values[op.in[0]] ^ values[op.in[1]];
+                break;
+            case op_t::LUT:
+                // The table is folded one input at a time, as a tree of multiplexers
+                table.resize(op.table.size());
+                for (size_t m = 0; m < table.size(); m++)
+                    table[m] = op.table[m] ? ~uint64_t(0) : 0;
+                for (size_t i = 0, size = table.size(); i < op.in.size(); i++, size /= 2) {
+                    auto x = values[op.in[i]];
+                    for (size_t j = 0; j < size / 2; j++)
+                        table[j] = (x & table[2 * j + 1]) | (~x & table[2 * j]);
+                }
+                values[op.out] = table[0];
+                break;
+        }
+    }
+
+    std::vector<uint64_t> output_words;
+    output_words.reserve(output_nodes.size());
+    for (auto node : output_nodes)
+        output_words.push_back(values[node]);
+
+    return output_words;
+}
+}
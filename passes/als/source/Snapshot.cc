@@ -0,0 +1,240 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Immutable snapshot of the catalogue for Yosys ALS module
+ */
+
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yosys_als {
+
+/*
+ * File format
+ */
+
+/// File header
+struct Snapshot::header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t encoding_version;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+/// A record, i.e. a key and its model
+struct Snapshot::record_t {
+    uint64_t spec;
+    uint64_t fun_spec;
+    uint8_t arity;
+    uint8_t distance;
+    uint8_t num_gates;
+    uint8_t out;
+    uint8_t out_p;
+    uint8_t optimal;
+    uint8_t padding[2];
+    uint8_t s[max_gates][2];
+    uint8_t p[max_gates][2];
+
+    std::tuple<uint8_t, uint64_t, uint8_t> key() const {
+        return std::make_tuple(arity, spec, distance);
+    }
+};
+
+static const char snapshot_magic[8] = {'A', 'L', 'S', 'S', 'N', 'A', 'P', '\0'};
+static constexpr uint32_t snapshot_version = 2;
+
+/*
+ * Utility functions and procedures
+ */
+
+/**
+ * @brief Splits a key into the fields of a record
+ * @return \c false if the key cannot be stored in a record, otherwise \c true
+ */
+static bool key_to_record(const std::string &key, uint8_t &arity, uint64_t &spec, uint8_t &distance) {
+    auto at = key.find('@');
+    if (at == std::string::npos || at == 0 || at > 64 || (at & (at - 1)) != 0 || at + 1 == key.size())
+        return false;
+
+    auto dist = std::stoul(key.substr(at + 1));
+    if (dist > 255)
+        return false;
+
+    arity = 0;
+    while ((1ul << arity) < at)
+        arity++;
+    spec = std::stoull(key.substr(0, at), nullptr, 2);
+    distance = static_cast<uint8_t>(dist);
+
+    return true;
+}
+
+/*
+ * Exposed methods
+ */
+
+Snapshot::Snapshot(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open snapshot " + path + ".");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(header_t)) {
+        close(fd);
+        throw std::runtime_error("Invalid snapshot " + path + ".");
+    }
+
+    data_size = st.st_size;
+    data = mmap(nullptr, data_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        data = nullptr;
+        throw std::runtime_error("Cannot map snapshot " + path + ".");
+    }
+
+    auto header = static_cast<const header_t *>(data);
+    if (std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0 ||
+        header->version != snapshot_version || header->record_size != sizeof(record_t) ||
+        header->encoding_version != smt_encoding_version ||
+        header->count > (data_size - sizeof(header_t)) / sizeof(record_t)) {
+        munmap(data, data_size);
+        data = nullptr;
+        throw std::runtime_error("Invalid snapshot " + path + ".");
+    }
+
+    records = reinterpret_cast<const record_t *>(static_cast<const char *>(data) + sizeof(header_t));
+    count = header->count;
+}
+
+Snapshot::~Snapshot() {
+    if (data != nullptr)
+        munmap(data, data_size);
+}
+
+bool Snapshot::lookup(const std::string &key, aig_model_t &aig) const {
+    uint8_t arity, distance;
+    uint64_t spec;
+    if (!key_to_record(key, arity, spec, distance))
+        return false;
+
+    auto wanted = std::make_tuple(arity, spec, distance);
+    auto record = std::lower_bound(records, records + count, wanted,
+                                   [](const record_t &r, const std::tuple<uint8_t, uint64_t, uint8_t> &k) {
+                                       return r.key() < k;
+                                   });
+    if (record == records + count || record->key() != wanted)
+        return false;
+
+    aig = aig_model_t();
+    aig.fun_spec = boost::dynamic_bitset<>(1ul << record->arity, record->fun_spec);
+    aig.num_inputs = record->arity + 1;
+    aig.num_gates = record->num_gates;
+    for (size_t i = 0; i < aig.num_inputs; i++) {
+        aig.s.emplace_back(std::array<size_t, 2>{i, i});
+        aig.p.emplace_back(std::array<bool, 2>{true, true});
+    }
+    for (size_t i = 0; i < aig.num_gates; i++) {
+        aig.s.emplace_back(std::array<size_t, 2>{record->s[i][0], record->s[i][1]});
+        aig.p.emplace_back(std::array<bool, 2>{record->p[i][0] != 0, record->p[i][1] != 0});
+    }
+    aig.out = record->out;
+    aig.out_p = record->out_p != 0;
+    aig.is_valid = true;
+    aig.is_optimal = record->optimal != 0;
+
+    return true;
+}
+
+size_t Snapshot::size() const {
+    return count;
+}
+
+size_t Snapshot::write(const std::string &path, const std::vector<std::pair<std::string, aig_model_t>> &entries) {
+    std::vector<record_t> to_write;
+
+    for (auto &entry : entries) {
+        auto &aig = entry.second;
+        record_t record;
+        std::memset(&record, 0, sizeof(record));
+
+        if (!aig.is_valid || aig.num_gates > max_gates || aig.fun_spec.size() > 64 ||
+            !key_to_record(entry.first, record.arity, record.spec, record.distance) ||
+            aig.num_inputs != record.arity + 1u)
+            continue;
+
+        record.fun_spec = aig.fun_spec.to_ulong();
+        record.num_gates = aig.num_gates;
+        record.out = aig.out;
+        record.out_p = aig.out_p;
+        record.optimal = aig.is_optimal;
+        for (size_t i = 0; i < aig.num_gates; i++) {
+            for (size_t c = 0; c < 2; c++) {
+                record.s[i][c] = aig.s[aig.num_inputs + i][c];
+                record.p[i][c] = aig.p[aig.num_inputs + i][c];
+            }
+        }
+
+        to_write.push_back(record);
+    }
+
+    std::sort(to_write.begin(), to_write.end(), [](const record_t &a, const record_t &b) {
+        return a.key() < b.key();
+    });
+
+    header_t header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = snapshot_version;
+    header.record_size = sizeof(record_t);
+    header.encoding_version = smt_encoding_version;
+    header.count = to_write.size();
+
+    // Write a temporary file and rename it, so that mapped snapshots are never modified
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr)
+        throw std::runtime_error("Cannot write snapshot " + tmp_path + ".");
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (!to_write.empty())
+        ok = ok && fwrite(to_write.data(), sizeof(record_t), to_write.size(), f) == to_write.size();
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Cannot write snapshot " + path + ".");
+    }
+
+    return to_write.size();
+}
+}
@@ -35,6 +35,8 @@
 
 #include "AlsWorker.h"
 
+#include <fstream>
+
 USING_YOSYS_NAMESPACE
 
 /**
@@ -53,7 +55,15 @@ struct AlsPass : public Pass {
         log("\n");
         log("    als [options] [selection]\n");
         log("\n");
-        log("This command executes an approximate logic synthesis.\n");
+        log("This command executes an approximate logic synthesis of the top module, or of\n");
+        log("the selected modules. Selected modules are synthesized together, so that LUTs\n");
+        log("they share are synthesized once, and optimized concurrently. Among several\n");
+        log("selected modules, those that instantiate other modules are skipped, as their\n");
+        log("submodules are approximated on their own.\n");
+        log("The archive of results is written to the als_<module> directory: log.txt holds\n");
+        log("a summary, variants.txt the variants for als_apply, and archive.json and\n");
+        log("archive.csv a record for each variant, with its objectives, number of gates,\n");
+        log("fidelity of the error, power, size estimate and level of each LUT.\n");
         log("\n");
         log("    -m <metric>\n");
         log("        select the metric (default: ers).\n");
@@ -63,6 +73,22 @@ struct AlsPass : public Pass {
         log("        set the weight for the output signal to the specified power of two.\n");
         log("\n");
         log("\n");
+        log("    -p <signal> <probability>\n");
+        log("        with the ers metric, set the probability of each bit of the input signal\n");
+        log("        being one (default: 0.5).\n");
+        log("\n");
+        log("\n");
+        log("    -dist <signal> <file>\n");
+        log("        with the ers metric, draw the values of the input signal, of at most 64\n");
+        log("        bits, from the histogram in the specified file. Each line holds a value,\n");
+        log("        decimal or with the 0x or 0b prefix, and optionally its weight (default:\n");
+        log("        1), so a trace of the values of the signal is a histogram too.\n");
+        log("        When the inputs have fewer combinations with non-zero probability than\n");
+        log("        test vectors, all of them are evaluated, weighted by their probability.\n");
+        log("        Otherwise, test vectors are stratified: each signal with a histogram,\n");
+        log("        and each other bit, takes every value in proportion to its probability.\n");
+        log("\n");
+        log("\n");
         log("    -i <value>\n");
         log("        set the number of iterations for the optimizer.\n");
         log("\n");
@@ -75,8 +101,76 @@ struct AlsPass : public Pass {
         log("        set the number of test vectors for the evaluator.\n");
         log("\n");
         log("\n");
+        log("    -batch <value>\n");
+        log("        with the ers metric, set the number of test vectors of each step of the\n");
+        log("        sequential evaluation of the error (default: 256). A candidate solution\n");
+        log("        is evaluated until the confidence interval of its error excludes the\n");
+        log("        error of the solution it is compared with, so only close calls take all\n");
+        log("        the test vectors. The 5%% significance is shared among the steps, so that\n");
+        log("        early decisions are as reliable as a single test. The final archive is\n");
+        log("        evaluated on all of them. With 0, or with the weighted test vectors of\n");
+        log("        -dist, candidates are evaluated on all the test vectors.\n");
+        log("\n");
+        log("\n");
+        log("    -screen\n");
+        log("        with the ers metric, screen candidate solutions by an analytical\n");
+        log("        estimate of the error rate, which propagates signal and error\n");
+        log("        probabilities through the LUTs instead of simulating test vectors.\n");
+        log("        Solutions are evaluated by simulation when they enter the archive.\n");
+        log("        Useful for very large circuits.\n");
+        log("\n");
+        log("\n");
+        log("    -c <file>\n");
+        log("        use the specified catalogue of synthesized LUTs (default: catalogue.db).\n");
+        log("        the catalogue can be shared by concurrent processes.\n");
+        log("\n");
+        log("\n");
+        log("    -s <value>\n");
+        log("        set the seed of the random number generator.\n");
+        log("\n");
+        log("\n");
+        log("    -results <dir>\n");
+        log("        store the results of each run in the specified directory (default:\n");
+        log("        .als_cache). When a module is run again with the same options and seed,\n");
+        log("        LUT mapping, synthesis and optimization are skipped and the stored\n");
+        log("        results are written again. Without -s, the stored results of any\n");
+        log("        previous run without -s are reused.\n");
+        log("\n");
+        log("\n");
+        log("    -rerun\n");
+        log("        ignore stored results, and store the results of this run.\n");
+        log("\n");
+        log("\n");
+        log("    -power\n");
+        log("        with the ers metric, make switching power a third objective besides\n");
+        log("        error and gates. Power is estimated from the toggles of the LUTs between\n");
+        log("        test vectors, weighted by their gates, and is reported for every metric.\n");
+        log("\n");
+        log("\n");
+        log("    -estimate\n");
+        log("        map each variant to 6-input LUTs with abc, and report the number of LUTs\n");
+        log("        and the depth in the archive. This is much faster than vendor synthesis,\n");
+        log("        and can be used to choose the variants to synthesize.\n");
+        log("\n");
+        log("\n");
+        log("    -mmap\n");
+        log("        keep the golden outputs of the evaluator, packed one bit per vector,\n");
+        log("        in a memory-mapped file in the als_<module> directory. The file is\n");
+        log("        reused by later runs on the same module with the same options and\n");
+        log("        test vectors, which saves the exhaustive simulation of epsmax.\n");
+        log("\n");
+        log("\n");
+        log("    -window <size>\n");
+        log("        with the ers metric, partition modules with more than the specified\n");
+        log("        number of LUTs in windows of consecutive logic levels, cut where the\n");
+        log("        fewest signals cross. Windows are optimized concurrently, with cut\n");
+        log("        signals as their inputs and outputs, and their fronts are composed by\n");
+        log("        sharing each error budget among them. Composed variants are evaluated\n");
+        log("        on the whole module.\n");
+        log("\n");
+        log("\n");
         log("    -r\n");
-        log("        run AIG rewriting of top module\n");
+        log("        run AIG rewriting of the modules\n");
         log("\n");
         log("\n");
         log("    -d\n");
@@ -90,11 +184,12 @@ struct AlsPass : public Pass {
 
         AlsWorker worker;
         std::vector<std::pair<std::string, std::string>> weights;
+        std::vector<std::pair<std::string, std::string>> probabilities;
+        std::vector<std::pair<std::string, std::string>> histograms;
         std::string max_iter = "2500";
         std::string test_vectors_n = "1000";
         std::string max_tries = "20";
 
-        // TODO Add arguments for specifying input probability
         size_t argidx;
         for (argidx = 1; argidx < args.size(); argidx++) {
             if (args[argidx] == "-m" && argidx + 1 < args.size()) {
@@ -103,6 +198,14 @@ struct AlsPass : public Pass {
                 std::string lhs = args[++argidx];
                 std::string rhs = args[++argidx];
                 weights.emplace_back(lhs, rhs);
+            } else if (args[argidx] == "-p" && argidx + 2 < args.size()) {
+                std::string lhs = args[++argidx];
+                std::string rhs = args[++argidx];
+                probabilities.emplace_back(lhs, rhs);
+            } else if (args[argidx] == "-dist" && argidx + 2 < args.size()) {
+                std::string lhs = args[++argidx];
+                std::string rhs = args[++argidx];
+                histograms.emplace_back(lhs, rhs);
             } else if (args[argidx] == "-i" && argidx + 1 < args.size()) {
                 std::string arg = args[++argidx];
                 max_iter = arg;
@@ -112,6 +215,26 @@ struct AlsPass : public Pass {
             } else if (args[argidx] == "-v" && argidx + 1 < args.size()) {
                 std::string arg = args[++argidx];
                 test_vectors_n = arg;
+            } else if (args[argidx] == "-batch" && argidx + 1 < args.size()) {
+                worker.batch_size = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-screen") {
+                worker.screen = true;
+            } else if (args[argidx] == "-c" && argidx + 1 < args.size()) {
+                worker.catalogue_path = args[++argidx];
+            } else if (args[argidx] == "-s" && argidx + 1 < args.size()) {
+                worker.seed = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-results" && argidx + 1 < args.size()) {
+                worker.result_cache_path = args[++argidx];
+            } else if (args[argidx] == "-rerun") {
+                worker.rerun = true;
+            } else if (args[argidx] == "-power") {
+                worker.power_objective = true;
+            } else if (args[argidx] == "-estimate") {
+                worker.estimate = true;
+            } else if (args[argidx] == "-mmap") {
+                worker.map_golden = true;
+            } else if (args[argidx] == "-window" && argidx + 1 < args.size()) {
+                worker.window_size = std::stoul(args[++argidx]);
             } else if (args[argidx] == "-d") {
                 worker.debug = true;
             } else if (args[argidx] == "-r") {
@@ -124,40 +247,132 @@ struct AlsPass : public Pass {
             worker.metric = "ers";
         }
 
-        Module *top_mod = nullptr;
+        if (worker.power_objective && worker.metric == "epsmax")
+            log_cmd_error("Option -power requires the ers metric.\n");
+
+        if (worker.screen && worker.metric == "epsmax")
+            log_cmd_error("Option -screen requires the ers metric.\n");
+
+        if (worker.window_size > 0 && worker.metric == "epsmax")
+            log_cmd_error("Option -window requires the ers metric.\n");
+
+        if ((!probabilities.empty() || !histograms.empty()) && worker.metric == "epsmax")
+            log_cmd_error("Options -p and -dist require the ers metric.\n");
+
+        std::vector<Module *> modules;
 
         if (design->full_selection()) {
-            top_mod = design->top_module();
+            auto top_mod = design->top_module();
 
             if (!top_mod)
                 log_cmd_error("Design has no top module, use the 'hierarchy' command to specify one.\n");
+            modules.push_back(top_mod);
         } else {
-            auto mods = design->selected_whole_modules();
+            auto selected = design->selected_whole_modules();
+            for (auto module : selected) {
+                if (GetSize(selected) > 1 && has_submodules(module)) {
+                    log("Skipping module %s, which instantiates other modules.\n", log_id(module));
+                    continue;
+                }
+                modules.push_back(module);
+            }
 
-            if (GetSize(mods) != 1)
-                log_cmd_error("Only one top module must be selected.\n");
+            if (modules.empty())
+                log_cmd_error("No module to approximate is selected.\n");
+        }
+
+        for (auto module : modules) {
+            worker.weights[module->name];
+            worker.distributions[module->name];
 
-            top_mod = mods.front();
+            size_t instances = 0;
+            for (auto parent : design->modules())
+                for (auto cell : parent->cells())
+                    instances += cell->type == module->name;
+            if (instances > 1)
+                log("Module %s has %zu instances, it is approximated once for all of them.\n", log_id(module),
+                    instances);
         }
 
+        // Each weight applies to the selected modules that have the output
         for (auto &w : weights) {
-            RTLIL::SigSpec lhs;
-            if (!RTLIL::SigSpec::parse_sel(lhs, design, top_mod, w.first))
-                log_cmd_error("Failed to parse lhs weight expression `%s'.\n", w.first.c_str());
-            if (!lhs.is_wire() || !lhs.as_wire()->port_output)
-                log_cmd_error("Lhs weight expression `%s' not an output.\n", w.first.c_str());
+            bool found = false;
+            for (auto module : modules) {
+                RTLIL::SigSpec lhs;
+                if (RTLIL::SigSpec::parse_sel(lhs, design, module, w.first) && lhs.is_wire() &&
+                    lhs.as_wire()->port_output) {
+                    worker.weights[module->name][lhs] = std::stod(w.second);
+                    found = true;
+                }
+            }
+
+            if (!found)
+                log_cmd_error("Lhs weight expression `%s' not an output of the selected modules.\n", w.first.c_str());
+        }
 
-            worker.weights[lhs] = std::stod(w.second);
+        // Each distribution applies to the selected modules that have the input
+        for (auto &p : probabilities) {
+            signal_distribution_t d;
+            d.probability = std::stod(p.second);
+            if (!(d.probability >= 0.0 && d.probability <= 1.0))
+                log_cmd_error("Probability %s of input `%s' is not between 0 and 1.\n", p.second.c_str(),
+                              p.first.c_str());
+            add_distribution(worker, design, modules, p.first, d);
+        }
+
+        for (auto &h : histograms) {
+            signal_distribution_t d;
+            std::ifstream histogram_file(h.second);
+            if (!histogram_file)
+                log_cmd_error("Cannot open histogram file %s.\n", h.second.c_str());
+            if (!read_histogram(histogram_file, 64, d.histogram))
+                log_cmd_error("Invalid histogram file %s.\n", h.second.c_str());
+            add_distribution(worker, design, modules, h.first, d);
         }
 
         worker.max_iter = std::stoul(max_iter);
         worker.test_vectors_n = std::stoul(test_vectors_n);
         worker.max_tries = std::stoul(max_tries);
 
-        worker.run(top_mod);
+        worker.run(modules);
 
         log_pop();
     }
+
+private:
+    static void add_distribution(AlsWorker &worker, Design *design, const std::vector<Module *> &modules,
+                                 const std::string &expr, signal_distribution_t d) {
+        bool found = false;
+        for (auto module : modules) {
+            RTLIL::SigSpec lhs;
+            if (!RTLIL::SigSpec::parse_sel(lhs, design, module, expr) || !lhs.is_wire() ||
+                !lhs.as_wire()->port_input)
+                continue;
+
+            if (!d.histogram.empty() && lhs.size() > 64)
+                log_cmd_error("Input `%s' is wider than 64 bits, it cannot have a histogram.\n", expr.c_str());
+            for (auto &h : d.histogram) {
+                if (lhs.size() < 64 && h.first >> lhs.size() != 0)
+                    log_cmd_error("Value %llu of the histogram does not fit input `%s'.\n",
+                                  static_cast<unsigned long long>(h.first), expr.c_str());
+            }
+
+            d.signal = lhs;
+            worker.distributions[module->name].push_back(d);
+            found = true;
+        }
+
+        if (!found)
+            log_cmd_error("Expression `%s' not an input of the selected modules.\n", expr.c_str());
+    }
+
+    static bool has_submodules(Module *module) {
+        for (auto cell : module->cells()) {
+            if (module->design->module(cell->type) != nullptr)
+                return true;
+        }
+        return false;
+    }
 } AlsPass;
 
 } // namespace yosys_als
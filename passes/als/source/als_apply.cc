@@ -0,0 +1,294 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Variant materialization pass for Yosys ALS module
+ */
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "AigRewriter.h"
+#include "Catalogue.h"
+#include "variants.h"
+#include "yosys_utils.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/**
+ * \brief Yosys ALS variant materialization pass
+ */
+struct AlsApplyPass : public Pass {
+    AlsApplyPass() : Pass("als_apply", "apply a variant found by the als pass") {}
+
+    void help() YS_OVERRIDE {
+        //   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+        log("\n");
+        log("    als_apply [options] <entry> [selection]\n");
+        log("    als_apply [options] -all [selection]\n");
+        log("\n");
+        log("This command sets the LUTs of the exact circuit to those of an entry of the\n");
+        log("archive of results of the als pass, as numbered in its log.txt. The exact\n");
+        log("circuit is the design after the als pass, or its exact.ilang file. Use als -r\n");
+        log("afterwards to rewrite the LUTs as AIGs.\n");
+        log("\n");
+        log("    -f <file>\n");
+        log("        read the variants from the specified file (default:\n");
+        log("        als_<module>/variants.txt).\n");
+        log("\n");
+        log("\n");
+        log("    -all\n");
+        log("        write every entry to variant_<entry + 1> in the output directory, in the\n");
+        log("        formats listed below (default: -ilang), leaving the design unchanged.\n");
+        log("\n");
+        log("\n");
+        log("    -ilang, -verilog, -blif, -aiger\n");
+        log("        with -all, write the entries in RTLIL, Verilog, BLIF or AIGER format.\n");
+        log("\n");
+        log("\n");
+        log("    -rewrite\n");
+        log("        with -all, rewrite the LUTs as AIGs before writing the entries, as\n");
+        log("        als -r does. Each LUT specification is looked up once for all entries.\n");
+        log("        Required by -aiger.\n");
+        log("\n");
+        log("\n");
+        log("    -c <file>\n");
+        log("        with -rewrite, use the specified catalogue (default: catalogue.db).\n");
+        log("\n");
+        log("\n");
+        log("    -t <value>\n");
+        log("        with -rewrite, set the maximum tries for SMT synthesis of LUTs that\n");
+        log("        are missing from the catalogue, as als -t does (default: 20).\n");
+        log("\n");
+        log("\n");
+        log("    -o <dir>\n");
+        log("        with -all, set the output directory (default: the directory of the\n");
+        log("        variants file).\n");
+        log("\n");
+        log("\n");
+        log("    -j <value>\n");
+        log("        with -all, set the number of worker processes (default: number of\n");
+        log("        cores). Each entry is written by a worker forked from the design.\n");
+        log("\n");
+    }
+
+    void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE {
+        log_header(design, "Executing ALS_APPLY pass (apply a variant found by the als pass).\n");
+        log_push();
+
+        std::string variants_path;
+        std::string output_dir;
+        unsigned int worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+        std::string catalogue_path = "catalogue.db";
+        size_t max_tries = 20;
+        std::vector<std::string> formats;
+        bool all = false;
+        bool rewrite = false;
+
+        size_t argidx;
+        for (argidx = 1; argidx < args.size(); argidx++) {
+            if (args[argidx] == "-f" && argidx + 1 < args.size()) {
+                variants_path = args[++argidx];
+            } else if (args[argidx] == "-o" && argidx + 1 < args.size()) {
+                output_dir = args[++argidx];
+            } else if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+                worker_count = std::max(static_cast<unsigned int>(std::stoul(args[++argidx])), 1u);
+            } else if (args[argidx] == "-c" && argidx + 1 < args.size()) {
+                catalogue_path = args[++argidx];
+            } else if (args[argidx] == "-t" && argidx + 1 < args.size()) {
+                max_tries = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-ilang" || args[argidx] == "-verilog" || args[argidx] == "-blif" ||
+                       args[argidx] == "-aiger") {
+                formats.push_back(args[argidx].substr(1));
+            } else if (args[argidx] == "-rewrite") {
+                rewrite = true;
+            } else if (args[argidx] == "-all") {
+                all = true;
+            } else {
+                break;
+            }
+        }
+
+        size_t entry = 0;
+        if (!all) {
+            if (argidx >= args.size())
+                log_cmd_error("Missing archive entry.\n");
+            entry = std::stoul(args[argidx++]);
+        }
+        extra_args(args, argidx, design);
+
+        Module *top_mod = nullptr;
+
+        if (design->full_selection()) {
+            top_mod = design->top_module();
+
+            if (!top_mod)
+                log_cmd_error("Design has no top module, use the 'hierarchy' command to specify one.\n");
+        } else {
+            auto mods = design->selected_whole_modules();
+
+            if (GetSize(mods) != 1)
+                log_cmd_error("Only one top module must be selected.\n");
+
+            top_mod = mods.front();
+        }
+
+        if (variants_path.empty())
+            variants_path = std::string("als_") + (top_mod->name.c_str() + 1) + "/variants.txt";
+
+        std::ifstream variants_file(variants_path);
+        std::vector<variant_t> variants;
+        if (!variants_file || !read_variant_set(variants_file, variants))
+            log_cmd_error("Cannot read variants from %s.\n", variants_path.c_str());
+        if (all) {
+            if (output_dir.empty())
+                output_dir = boost::filesystem::path(variants_path).parent_path().string();
+            if (output_dir.empty())
+                output_dir = ".";
+            boost::filesystem::create_directories(output_dir);
+
+            if (formats.empty())
+                formats.push_back("ilang");
+            if (!rewrite && std::find(formats.begin(), formats.end(), "aiger") != formats.end())
+                log_cmd_error("AIGER output requires -rewrite.\n");
+
+            check_variants(top_mod, variants);
+
+            // Models are looked up before forking, so that workers share them
+            dict<Const, aig_model_t> aigs;
+            if (rewrite) {
+                try {
+                    Catalogue catalogue(catalogue_path);
+                    for (auto cell : top_mod->cells()) {
+                        if (is_lut(cell) && !aigs.count(get_lut_param(cell)))
+                            aigs[get_lut_param(cell)] = synthesize_lut(get_lut_param(cell), 0, max_tries, false,
+                                                                       &catalogue);
+                    }
+                    for (auto &variant : variants) {
+                        for (auto &lut : variant.luts) {
+                            if (!aigs.count(lut.second))
+                                aigs[lut.second] = synthesize_lut(lut.second, 0, max_tries, false, &catalogue);
+                        }
+                    }
+                } catch (const std::runtime_error &e) {
+                    log_cmd_error("%s\n", e.what());
+                }
+                log("Looked up %zu LUT specifications.\n", aigs.size());
+            }
+
+            write_all(top_mod, variants, output_dir, formats, rewrite ? &aigs : nullptr, worker_count);
+            log_pop();
+            return;
+        }
+
+        if (entry >= variants.size())
+            log_cmd_error("Entry %zu is out of range, %s holds %zu variants.\n",
+                          entry, variants_path.c_str(), variants.size());
+
+        auto mismatches = apply_variant(top_mod, variants[entry]);
+        if (mismatches > 0)
+            log_cmd_error("%zu LUTs of entry %zu do not match module %s.\n", mismatches, entry, log_id(top_mod));
+
+        log("Applied entry %zu to %zu LUTs of module %s (%g, %g).\n", entry, variants[entry].luts.size(),
+            log_id(top_mod), variants[entry].value[0], variants[entry].value[1]);
+
+        log_pop();
+    }
+
+private:
+    static void check_variants(Module *module, const std::vector<variant_t> &variants) {
+        dict<IdString, Const> exact;
+        for (auto cell : module->cells()) {
+            if (is_lut(cell))
+                exact[cell->name] = get_lut_param(cell);
+        }
+
+        for (size_t i = 0; i < variants.size(); i++) {
+            for (auto &lut : variants[i].luts) {
+                auto it = exact.find(lut.first);
+                if (it == exact.end() || it->second.size() != lut.second.size())
+                    log_cmd_error("Entry %zu does not match module %s.\n", i, log_id(module));
+            }
+        }
+    }
+
+    static void write_all(Module *module, const std::vector<variant_t> &variants, const std::string &output_dir,
+                          const std::vector<std::string> &formats, const dict<Const, aig_model_t> *aigs,
+                          unsigned int worker_count) {
+        // Yosys global state is not thread-safe, so each entry is written by a process forked from the design
+        log("Writing %zu variants to %s with %u workers.\n", variants.size(), output_dir.c_str(), worker_count);
+
+        std::vector<std::string> names;
+        for (size_t i = 0; i < variants.size(); i++)
+            names.push_back(variant_file_name(i));
+
+        run_forked(names, [&](size_t i) {
+            materialize(module, variants[i], output_dir + "/" + names[i], formats, aigs);
+            return std::string();
+        }, [](size_t, const std::string &) {}, worker_count);
+    }
+
+    static void materialize(Module *module, const variant_t &variant, const std::string &path_prefix,
+                            const std::vector<std::string> &formats, const dict<Const, aig_model_t> *aigs) {
+        apply_variant(module, variant);
+
+        if (aigs != nullptr) {
+            std::vector<Cell *> to_sub;
+            for (auto cell : module->cells()) {
+                if (is_lut(cell))
+                    to_sub.push_back(cell);
+            }
+
+            AigRewriter rewriter(module);
+            for (auto cell : to_sub)
+                rewriter.replace(cell, aigs->at(get_lut_param(cell)));
+            Pass::call(module->design, "clean");
+        }
+
+        for (auto &format : formats) {
+            if (format == "ilang")
+                Pass::call(module->design, "write_ilang " + path_prefix + ".ilang");
+            else if (format == "verilog")
+                Pass::call(module->design, "write_verilog " + path_prefix + ".v");
+            else if (format == "blif")
+                Pass::call(module->design, "write_blif " + path_prefix + ".blif");
+            else if (format == "aiger")
+                Pass::call(module->design, "write_aiger " + path_prefix + ".aig");
+        }
+    }
+} AlsApplyPass;
+
+} // namespace yosys_als
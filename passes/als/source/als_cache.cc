@@ -0,0 +1,281 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Catalogue maintenance pass for Yosys ALS module
+ */
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "Catalogue.h"
+#include "smt_utils.h"
+#include "smtsynth.h"
+
+#include <thread>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/**
+ * \brief Yosys ALS catalogue maintenance pass
+ */
+struct AlsCachePass : public Pass {
+    AlsCachePass() : Pass("als_cache", "maintain the catalogue of synthesized LUTs") {}
+
+    void help() YS_OVERRIDE {
+        //   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+        log("\n");
+        log("    als_cache [options]\n");
+        log("\n");
+        log("This command maintains the catalogue of synthesized LUTs used by the als pass.\n");
+        log("Operations are executed in the order in which they are listed here.\n");
+        log("\n");
+        log("    -c <file>\n");
+        log("        use the specified catalogue (default: catalogue.db).\n");
+        log("\n");
+        log("\n");
+        log("    -import <file>\n");
+        log("        merge the entries of a bundle exported by another catalogue.\n");
+        log("        entries that are already present are replaced only by better ones, i.e.\n");
+        log("        proven minimal or with fewer gates.\n");
+        log("\n");
+        log("\n");
+        log("    -invalidate\n");
+        log("        remove the entries and time-outs stored by older versions of the SMT\n");
+        log("        encoding, which are never used.\n");
+        log("\n");
+        log("\n");
+        log("    -suboptimal\n");
+        log("        with -invalidate, also remove the entries that are not proven minimal.\n");
+        log("\n");
+        log("\n");
+        log("    -verify\n");
+        log("        simulate each stored AIG and check it against the key of its entry.\n");
+        log("\n");
+        log("\n");
+        log("    -purge\n");
+        log("        with -verify, remove the entries that fail verification.\n");
+        log("\n");
+        log("\n");
+        log("    -vacuum\n");
+        log("        drop expired claims and compact the catalogue file.\n");
+        log("\n");
+        log("\n");
+        log("    -export <file>\n");
+        log("        copy all the entries to a bundle, merging them if the bundle exists.\n");
+        log("\n");
+        log("\n");
+        log("    -snapshot\n");
+        log("        compile the catalogue to an immutable snapshot file, named as the\n");
+        log("        catalogue with the .snap extension. The als pass looks up entries in the\n");
+        log("        snapshot first, if it exists. Compile the snapshot again to include\n");
+        log("        entries that were added to the catalogue later.\n");
+        log("\n");
+        log("\n");
+        log("    -stats\n");
+        log("        report entries, size and hit rate for each arity and distance.\n");
+        log("\n");
+    }
+
+    void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE {
+        log_header(design, "Executing ALS_CACHE pass (maintain the catalogue of synthesized LUTs).\n");
+        log_push();
+
+        std::string catalogue_path = "catalogue.db";
+        std::string import_path;
+        std::string export_path;
+        bool invalidate = false;
+        bool suboptimal = false;
+        bool verify = false;
+        bool purge = false;
+        bool vacuum = false;
+        bool snapshot = false;
+        bool stats = false;
+
+        size_t argidx;
+        for (argidx = 1; argidx < args.size(); argidx++) {
+            if (args[argidx] == "-c" && argidx + 1 < args.size()) {
+                catalogue_path = args[++argidx];
+            } else if (args[argidx] == "-import" && argidx + 1 < args.size()) {
+                import_path = args[++argidx];
+            } else if (args[argidx] == "-export" && argidx + 1 < args.size()) {
+                export_path = args[++argidx];
+            } else if (args[argidx] == "-invalidate") {
+                invalidate = true;
+            } else if (args[argidx] == "-suboptimal") {
+                suboptimal = true;
+            } else if (args[argidx] == "-verify") {
+                verify = true;
+            } else if (args[argidx] == "-purge") {
+                purge = true;
+            } else if (args[argidx] == "-vacuum") {
+                vacuum = true;
+            } else if (args[argidx] == "-snapshot") {
+                snapshot = true;
+            } else if (args[argidx] == "-stats") {
+                stats = true;
+            } else {
+                break;
+            }
+        }
+        extra_args(args, argidx, design, false);
+
+        try {
+            Catalogue catalogue(catalogue_path, false);
+
+            if (!import_path.empty()) {
+                auto imported = catalogue.import_bundle(import_path);
+                log("Imported %zu entries from %s.\n", imported, import_path.c_str());
+            }
+
+            if (invalidate) {
+                auto removed = catalogue.invalidate(suboptimal);
+                log("Invalidated %zu entries and time-outs.\n", removed);
+            }
+
+            if (verify)
+                verify_entries(catalogue, purge);
+
+            if (vacuum) {
+                auto before = catalogue.file_size();
+                catalogue.vacuum();
+                log("Vacuumed catalogue from %zu to %zu bytes.\n", before, catalogue.file_size());
+            }
+
+            if (!export_path.empty()) {
+                auto exported = catalogue.export_bundle(export_path);
+                log("Exported %zu entries to %s.\n", exported, export_path.c_str());
+            }
+
+            if (snapshot) {
+                auto compiled = catalogue.write_snapshot();
+                log("Compiled %zu entries to %s.\n", compiled, Catalogue::snapshot_path(catalogue_path).c_str());
+            }
+
+            if (stats)
+                print_stats(catalogue);
+        } catch (const std::runtime_error &e) {
+            log_cmd_error("%s\n", e.what());
+        }
+
+        log_pop();
+    }
+
+private:
+    static void verify_entries(Catalogue &catalogue, bool purge) {
+        auto entries = catalogue.entries();
+
+        auto processor_count = std::thread::hardware_concurrency();
+        processor_count = std::max(processor_count, 1u);
+        std::vector<std::vector<std::string>> failed_slices(processor_count);
+
+        size_t slice = entries.size() / processor_count + 1;
+        std::vector<std::thread> threads;
+
+        for (size_t j = 0; j < processor_count; j++) {
+            size_t start = j * slice;
+            size_t end = std::min(start + slice, entries.size());
+
+            threads.emplace_back([start, end, &entries, &failed_slices, j]() {
+                for (size_t i = start; i < end; i++) {
+                    if (!is_consistent(entries[i].first, entries[i].second))
+                        failed_slices[j].push_back(entries[i].first);
+                }
+            });
+        }
+
+        for (auto &t : threads)
+            t.join();
+
+        size_t failed = 0;
+        for (auto &failed_slice : failed_slices) {
+            for (auto &key : failed_slice) {
+                log("Entry %s failed verification.\n", key.c_str());
+                if (purge)
+                    catalogue.erase(key);
+                failed++;
+            }
+        }
+
+        log("Verified %zu entries, %zu failed%s.\n", entries.size(), failed, purge && failed > 0 ? " and were removed" : "");
+    }
+
+    static bool is_consistent(const std::string &key, const aig_model_t &aig) {
+        unsigned int arity, distance;
+        if (!parse_key(key, arity, distance) || !aig.is_valid || aig.num_inputs != arity + 1)
+            return false;
+
+        boost::dynamic_bitset<> spec(key.substr(0, key.find('@')));
+        if (spec.size() != 1ul << arity || aig.fun_spec.size() != spec.size())
+            return false;
+
+        for (size_t i = aig.num_inputs; i < aig.s.size(); i++) {
+            if (aig.s[i][0] >= i || aig.s[i][1] >= i)
+                return false;
+        }
+        if (aig.out >= aig.s.size() || aig.p.size() != aig.s.size())
+            return false;
+
+        auto fun = simulate_aig(aig);
+        return fun == aig.fun_spec && hamming_distance(fun, spec) <= distance;
+    }
+
+    static void print_stats(Catalogue &catalogue) {
+        auto stats = catalogue.stats();
+        catalogue_stats_t total;
+
+        log(" Arity Distance   Entries   Optimal  Timeouts     Stale        Bytes       Hits     Misses Hit rate\n");
+        log(" ----- -------- --------- --------- --------- --------- ------------ ---------- ---------- --------\n");
+        for (auto &s : stats) {
+            log(" %5u %8u %9zu %9zu %9zu %9zu %12zu %10zu %10zu %7.2f%%\n",
+                s.first.first, s.first.second, s.second.entries, s.second.optimal, s.second.timeouts,
+                s.second.stale, s.second.bytes, s.second.hits, s.second.misses, hit_rate(s.second));
+            total.entries += s.second.entries;
+            total.optimal += s.second.optimal;
+            total.stale += s.second.stale;
+            total.timeouts += s.second.timeouts;
+            total.bytes += s.second.bytes;
+            total.hits += s.second.hits;
+            total.misses += s.second.misses;
+        }
+        log(" ----- -------- --------- --------- --------- --------- ------------ ---------- ---------- --------\n");
+        log("   all      all %9zu %9zu %9zu %9zu %12zu %10zu %10zu %7.2f%%\n",
+            total.entries, total.optimal, total.timeouts, total.stale, total.bytes, total.hits, total.misses,
+            hit_rate(total));
+        log("\nCatalogue file size is %zu bytes.\n", catalogue.file_size());
+    }
+
+    static double hit_rate(const catalogue_stats_t &s) {
+        auto lookups = s.hits + s.misses;
+        return lookups > 0 ? 100.0 * s.hits / lookups : 0.0;
+    }
+} AlsCachePass;
+
+} // namespace yosys_als
@@ -0,0 +1,458 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Error verification pass for Yosys ALS module
+ */
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "Simulator.h"
+#include "bitslice.h"
+#include "variants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/**
+ * \brief Yosys ALS error verification pass
+ */
+struct AlsCheckPass : public Pass {
+    AlsCheckPass() : Pass("als_check", "check the error of a variant against the exact circuit") {}
+
+    void help() YS_OVERRIDE {
+        //   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+        log("\n");
+        log("    als_check [options] <gold> <gate>\n");
+        log("\n");
+        log("This command measures the error of the gate module, e.g. a variant written by\n");
+        log("als_apply and read with another name, with respect to the gold module, i.e. the\n");
+        log("exact circuit. Both modules are simulated 64 vectors at a time on all cores, on\n");
+        log("all the input vectors if there are few enough, otherwise on random ones. The\n");
+        log("modules must have the same ports and hold only $_AND_, $_NOT_, $_OR_, $_XOR_,\n");
+        log("$_BUF_ and $lut cells.\n");
+        log("\n");
+        log("    -m <metric>\n");
+        log("        select the metric, ers or epsmax (default: ers).\n");
+        log("\n");
+        log("\n");
+        log("    -w <signal> <value>\n");
+        log("        with epsmax, set the weight for the output signal of the gold module to\n");
+        log("        the specified power of two. Only weighted outputs are considered. By\n");
+        log("        default, the output bits are weighted by their position in the ports.\n");
+        log("\n");
+        log("\n");
+        log("    -v <value>\n");
+        log("        set the number of random vectors (default: 1048576). All the vectors are\n");
+        log("        simulated if they are not more.\n");
+        log("\n");
+        log("\n");
+        log("    -s <value>\n");
+        log("        set the seed of the random vectors (default: 1).\n");
+        log("\n");
+        log("\n");
+        log("    -j <value>\n");
+        log("        set the number of simulation threads (default: number of cores).\n");
+        log("\n");
+        log("\n");
+        log("    -entry <value>\n");
+        log("        compare the error with that of the entry of the archive of results of\n");
+        log("        the als pass. A discrepancy is reported if the error is not the same\n");
+        log("        when both are exact, or if their confidence bounds do not overlap.\n");
+        log("\n");
+        log("\n");
+        log("    -f <file>\n");
+        log("        with -entry, read the archive from the specified file (default:\n");
+        log("        als_<gold>/variants.txt).\n");
+        log("\n");
+        log("\n");
+        log("    -sat\n");
+        log("        if the vectors are not exhaustive, prove with a SAT miter that the error\n");
+        log("        is within the bound, i.e. the epsmax of the entry, or zero. With ers,\n");
+        log("        only equivalence can be proven.\n");
+        log("\n");
+        log("\n");
+        log("    -assert\n");
+        log("        produce an error if a discrepancy is found.\n");
+        log("\n");
+    }
+
+    void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE {
+        log_header(design, "Executing ALS_CHECK pass (check the error of a variant against the exact circuit).\n");
+        log_push();
+
+        std::string metric = "ers";
+        std::vector<std::pair<std::string, std::string>> weight_args;
+        size_t num_vectors = 1ul << 20;
+        uint64_t seed = 1;
+        unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        std::string variants_path;
+        bool has_entry = false;
+        size_t entry = 0;
+        bool sat = false;
+        bool assert_mode = false;
+
+        size_t argidx;
+        for (argidx = 1; argidx < args.size(); argidx++) {
+            if (args[argidx] == "-m" && argidx + 1 < args.size()) {
+                metric = args[++argidx];
+            } else if (args[argidx] == "-w" && argidx + 2 < args.size()) {
+                std::string lhs = args[++argidx];
+                std::string rhs = args[++argidx];
+                weight_args.emplace_back(lhs, rhs);
+            } else if (args[argidx] == "-v" && argidx + 1 < args.size()) {
+                num_vectors = std::max(std::stoul(args[++argidx]), 1ul);
+            } else if (args[argidx] == "-s" && argidx + 1 < args.size()) {
+                seed = std::stoull(args[++argidx]);
+            } else if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+                thread_count = std::max(static_cast<unsigned int>(std::stoul(args[++argidx])), 1u);
+            } else if (args[argidx] == "-entry" && argidx + 1 < args.size()) {
+                has_entry = true;
+                entry = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-f" && argidx + 1 < args.size()) {
+                variants_path = args[++argidx];
+            } else if (args[argidx] == "-sat") {
+                sat = true;
+            } else if (args[argidx] == "-assert") {
+                assert_mode = true;
+            } else {
+                break;
+            }
+        }
+        if (argidx + 2 != args.size())
+            log_cmd_error("Invalid number of arguments, the gold and gate modules are required.\n");
+        if (metric != "ers" && metric != "epsmax")
+            log_cmd_error("Unknown metric %s.\n", metric.c_str());
+
+        auto gold_name = args[argidx];
+        auto gate_name = args[argidx + 1];
+        auto gold = design->module(RTLIL::escape_id(gold_name));
+        auto gate = design->module(RTLIL::escape_id(gate_name));
+        if (gold == nullptr || gate == nullptr)
+            log_cmd_error("Cannot find module %s.\n", (gold == nullptr ? gold_name : gate_name).c_str());
+
+        std::unique_ptr<Simulator> gold_sim, gate_sim;
+        try {
+            gold_sim.reset(new Simulator(gold));
+            gate_sim.reset(new Simulator(gate));
+        } catch (const std::runtime_error &e) {
+            log_cmd_error("%s\n", e.what());
+        }
+        if (gold_sim->inputs() != gate_sim->inputs() || gold_sim->outputs() != gate_sim->outputs())
+            log_cmd_error("Modules %s and %s have different ports.\n", log_id(gold), log_id(gate));
+
+        auto weighted = weighted_outputs(design, gold, gold_sim->outputs(), weight_args);
+
+        variant_t variant;
+        if (has_entry) {
+            if (variants_path.empty())
+                variants_path = "als_" + RTLIL::unescape_id(gold->name) + "/variants.txt";
+
+            std::ifstream variants_file(variants_path);
+            std::vector<variant_t> variants;
+            if (!variants_file || !read_variant_set(variants_file, variants))
+                log_cmd_error("Cannot read variants from %s.\n", variants_path.c_str());
+            if (entry >= variants.size())
+                log_cmd_error("Entry %zu is out of range, %s holds %zu variants.\n",
+                              entry, variants_path.c_str(), variants.size());
+            variant = variants[entry];
+        }
+
+        // 1. Simulation
+        auto num_inputs = gold_sim->inputs().size();
+        bool exhaustive = num_inputs < 63 && (uint64_t(1) << num_inputs) <= num_vectors;
+        uint64_t total = exhaustive ? uint64_t(1) << num_inputs : num_vectors;
+
+        auto start_time = std::chrono::steady_clock::now();
+        auto result = simulate(*gold_sim, *gate_sim, weighted, metric == "epsmax", exhaustive, total, seed,
+                               thread_count);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        log("Simulated %llu %s vectors on %u threads in %.2f seconds.\n", static_cast<unsigned long long>(total),
+            exhaustive ? "exhaustive" : "random", thread_count, elapsed.count());
+
+        // 2. Comparison with the archive
+        std::array<double, 2> bounds;
+        double error;
+        bool discrepancy = false;
+        if (metric == "epsmax") {
+            error = result.max_distance;
+            bounds = {{error, exhaustive ? error : std::numeric_limits<double>::infinity()}};
+            log("Measured epsmax is %g%s.\n", error, exhaustive ? "" : " (lower bound)");
+
+            if (has_entry) {
+                discrepancy = error > variant.value[0] || (exhaustive && error < variant.value[0]);
+                log("Entry %zu reports epsmax %g.\n", entry, variant.value[0]);
+            }
+        } else {
+            error = static_cast<double>(result.errors) / total;
+            bounds = exhaustive ? std::array<double, 2>{{error, error}} : wilson_bounds(result.errors, total);
+            log("Measured error rate is %g (95%% confidence bounds %g to %g).\n", error, bounds[0], bounds[1]);
+
+            if (has_entry) {
+                if (exhaustive && variant.exhaustive)
+                    discrepancy = std::fabs(error - variant.value[0]) > 1e-9;
+                else
+                    discrepancy = bounds[1] < variant.error_bounds[0] || bounds[0] > variant.error_bounds[1];
+                log("Entry %zu reports error rate %g (95%% confidence bounds %g to %g).\n", entry,
+                    variant.value[0], variant.error_bounds[0], variant.error_bounds[1]);
+            }
+        }
+
+        // 3. SAT fallback
+        if (sat && !exhaustive) {
+            double bound = has_entry ? variant.value[0] : 0.0;
+            if (metric == "ers" && bound != 0.0) {
+                log("The error rate cannot be proven with SAT, only equivalence.\n");
+            } else {
+                bool proven = prove_bound(design, gold, gate, weighted, metric == "epsmax", bound);
+                if (proven)
+                    log("SAT proved that the %s is at most %g.\n", metric == "epsmax" ? "epsmax" : "error rate",
+                        bound);
+                else
+                    log("SAT could not prove that the %s is at most %g.\n",
+                        metric == "epsmax" ? "epsmax" : "error rate", bound);
+                discrepancy = discrepancy || !proven;
+            }
+        }
+
+        if (discrepancy) {
+            if (assert_mode)
+                log_error("Found a discrepancy between modules %s and %s.\n", log_id(gold), log_id(gate));
+            else
+                log_warning("Found a discrepancy between modules %s and %s.\n", log_id(gold), log_id(gate));
+        } else if (has_entry || sat) {
+            log("No discrepancy found.\n");
+        }
+
+        log_pop();
+    }
+
+private:
+    /// Type for an output bit and its weight, as a power of two
+    typedef std::pair<size_t, size_t> weighted_output_t;
+
+    /// Result of a simulation
+    struct result_t {
+        uint64_t errors = 0;
+        double max_distance = 0.0;
+    };
+
+    static std::vector<weighted_output_t> weighted_outputs(
+            Design *design, Module *module, const std::vector<port_bit_t> &outputs,
+            const std::vector<std::pair<std::string, std::string>> &weight_args) {
+        std::vector<weighted_output_t> weighted;
+
+        if (weight_args.empty()) {
+            for (size_t i = 0; i < outputs.size(); i++)
+                weighted.emplace_back(i, i);
+            return weighted;
+        }
+
+        for (auto &w : weight_args) {
+            RTLIL::SigSpec lhs;
+            if (!RTLIL::SigSpec::parse_sel(lhs, design, module, w.first))
+                log_cmd_error("Failed to parse lhs weight expression `%s'.\n", w.first.c_str());
+            if (lhs.size() != 1 || lhs.as_bit().wire == nullptr || !lhs.as_bit().wire->port_output)
+                log_cmd_error("Lhs weight expression `%s' not an output bit.\n", w.first.c_str());
+
+            auto bit = lhs.as_bit();
+            auto output = std::find(outputs.begin(), outputs.end(), port_bit_t(bit.wire->name, bit.offset));
+            if (output == outputs.end())
+                log_cmd_error("Lhs weight expression `%s' not an output bit.\n", w.first.c_str());
+            weighted.emplace_back(output - outputs.begin(), std::stoul(w.second));
+        }
+
+        return weighted;
+    }
+
+    /**
+     * @brief Computes a word of input bits
+     * Exhaustive vectors are numbered by block and bit, random vectors are hashed from the seed, so
+     * that the result does not depend on the number of threads.
+     */
+    static uint64_t input_word(bool exhaustive, uint64_t seed, uint64_t block, size_t input, size_t num_inputs) {
+        if (exhaustive)
+            return exhaustive_word(input, block);
+
+        // SplitMix64
+        uint64_t z = seed + (block * num_inputs + input + 1) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    static result_t simulate(const Simulator &gold_sim, const Simulator &gate_sim,
+                             const std::vector<weighted_output_t> &weighted, bool epsmax, bool exhaustive,
+                             uint64_t total, uint64_t seed, unsigned int thread_count) {
+        auto num_inputs = gold_sim.inputs().size();
+        uint64_t num_blocks = (total + 63) / 64;
+        std::atomic<uint64_t> next(0);
+        std::vector<result_t> results(thread_count);
+        std::vector<std::thread> threads;
+
+        for (size_t j = 0; j < thread_count; j++) {
+            threads.emplace_back([&, j]() {
+                std::vector<uint64_t> input_words(num_inputs);
+                for (uint64_t b = next++; b < num_blocks; b = next++) {
+                    for (size_t i = 0; i < num_inputs; i++)
+                        input_words[i] = input_word(exhaustive, seed, b, i, num_inputs);
+
+                    auto lanes = std::min<uint64_t>(64, total - b * 64);
+                    uint64_t mask = lanes == 64 ? ~uint64_t(0) : (uint64_t(1) << lanes) - 1;
+                    auto gold_words = gold_sim.simulate(input_words);
+                    auto gate_words = gate_sim.simulate(input_words);
+
+                    uint64_t diff = 0;
+                    for (size_t i = 0; i < gold_words.size(); i++)
+                        diff |= gold_words[i] ^ gate_words[i];
+                    diff &= mask;
+                    results[j].errors += __builtin_popcountll(diff);
+
+                    // Distances are only computed for the vectors with errors
+                    for (uint64_t lane = 0; epsmax && diff != 0; lane++, diff >>= 1) {
+                        if ((diff & 1u) == 0)
+                            continue;
+
+                        double distance = 0.0;
+                        for (auto &w : weighted) {
+                            double gold_bit = (gold_words[w.first] >> lane) & 1u;
+                            double gate_bit = (gate_words[w.first] >> lane) & 1u;
+                            distance += std::ldexp(gold_bit - gate_bit, w.second);
+                        }
+                        results[j].max_distance = std::max(results[j].max_distance, std::fabs(distance));
+                    }
+                }
+            });
+        }
+
+        for (auto &t : threads)
+            t.join();
+
+        result_t result;
+        for (auto &r : results) {
+            result.errors += r.errors;
+            result.max_distance = std::max(result.max_distance, r.max_distance);
+        }
+
+        return result;
+    }
+
+    static bool prove_bound(Design *design, Module *gold, Module *gate, const std::vector<weighted_output_t> &weighted,
+                            bool epsmax, double bound) {
+        log("Proving the bound with a SAT miter.\n");
+        log_flush();
+
+        // The miter is built and proven by a forked process, so that the design is left unchanged
+        pid_t pid = fork();
+        if (pid < 0)
+            log_error("Cannot start SAT worker: %s\n", strerror(errno));
+
+        if (pid == 0) {
+            log_files.clear();
+            log_streams.clear();
+
+            Pass::call(design, "miter -equiv -flatten -make_outputs " + RTLIL::unescape_id(gold->name) + " " +
+                               RTLIL::unescape_id(gate->name) + " als_check_miter");
+            auto miter = design->module("\\als_check_miter");
+            if (miter == nullptr)
+                _exit(1);
+
+            std::string target = "trigger";
+            if (epsmax) {
+                add_bound_check(miter, gold, weighted, bound);
+                target = "als_check_exceeds";
+            }
+
+            // A failed proof is an error, so the worker exits with a non-zero status
+            Pass::call(design, "sat -verify -prove " + target + " 0 als_check_miter");
+            log_flush();
+            _exit(0);
+        }
+
+        int status;
+        if (waitpid(pid, &status, 0) < 0)
+            return false;
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    static void add_bound_check(Module *miter, Module *gold, const std::vector<weighted_output_t> &weighted,
+                                double bound) {
+        Simulator gold_sim(gold);
+        auto &outputs = gold_sim.outputs();
+
+        // Sums are wide enough for all the weighted outputs, with a sign bit for their difference
+        size_t max_weight = 0;
+        for (auto &w : weighted)
+            max_weight = std::max(max_weight, w.second);
+        int width = max_weight + 2;
+        for (size_t n = weighted.size(); n > 1; n = (n + 1) / 2)
+            width++;
+
+        SigSpec gold_sum(State::S0, width);
+        SigSpec gate_sum(State::S0, width);
+        for (auto &w : weighted) {
+            auto &output = outputs[w.first];
+            auto port = RTLIL::unescape_id(output.first);
+
+            for (auto sum : {std::make_pair("\\gold_", &gold_sum), std::make_pair("\\gate_", &gate_sum)}) {
+                SigSpec term(State::S0, w.second);
+                term.append(SigBit(miter->wire(sum.first + port), output.second));
+                term.append(SigSpec(State::S0, width - w.second - 1));
+                *sum.second = miter->Add(NEW_ID, *sum.second, term);
+            }
+        }
+
+        auto diff = miter->Sub(NEW_ID, gold_sum, gate_sum, true);
+        auto abs_diff = miter->Mux(NEW_ID, diff, miter->Neg(NEW_ID, diff, true), diff[width - 1]);
+
+        std::vector<State> bound_bits;
+        auto bound_int = static_cast<uint64_t>(bound);
+        for (int i = 0; i < width; i++)
+            bound_bits.push_back(i < 64 && ((bound_int >> i) & 1u) ? State::S1 : State::S0);
+
+        auto exceeds = miter->addWire("\\als_check_exceeds");
+        miter->connect(exceeds, miter->Gt(NEW_ID, abs_diff, Const(bound_bits)));
+    }
+} AlsCheckPass;
+
+} // namespace yosys_als
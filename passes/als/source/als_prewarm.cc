@@ -0,0 +1,258 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Catalogue prewarming pass for Yosys ALS module
+ */
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#include "kernel/yosys.h"
+
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "Catalogue.h"
+#include "npn.h"
+#include "smt_utils.h"
+#include "yosys_utils.h"
+
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/**
+ * \brief Yosys ALS catalogue prewarming pass
+ */
+struct AlsPrewarmPass : public Pass {
+    AlsPrewarmPass() : Pass("als_prewarm", "pre-synthesize LUTs in the catalogue") {}
+
+    void help() YS_OVERRIDE {
+        //   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+        log("\n");
+        log("    als_prewarm [options] [selection]\n");
+        log("\n");
+        log("This command synthesizes exact and approximate AIGs for a set of functions and\n");
+        log("stores them in the catalogue, so that following runs of the als pass do not pay\n");
+        log("for SMT synthesis. By default, a representative of every NPN class is\n");
+        log("synthesized, and the results are stored for all the members of the class.\n");
+        log("Entries already in the catalogue are not synthesized again, so an interrupted\n");
+        log("run can be resumed by running the command again.\n");
+        log("\n");
+        log("    -k <arity>\n");
+        log("        set the number of inputs of the functions (default: 4, at most 4).\n");
+        log("\n");
+        log("\n");
+        log("    -seen\n");
+        log("        synthesize the functions of the LUTs in the selected modules instead of\n");
+        log("        the NPN classes.\n");
+        log("\n");
+        log("\n");
+        log("    -dist <min> <max>\n");
+        log("        set the range of output hamming distances (default: from 0 until the\n");
+        log("        synthesis times out or no gate is left).\n");
+        log("\n");
+        log("\n");
+        log("    -t <value>\n");
+        log("        set the maximum tries for SMT synthesis of approximate LUTs.\n");
+        log("\n");
+        log("\n");
+        log("    -j <value>\n");
+        log("        set the number of synthesis threads (default: number of cores).\n");
+        log("\n");
+        log("\n");
+        log("    -c <file>\n");
+        log("        use the specified catalogue (default: catalogue.db).\n");
+        log("\n");
+        log("\n");
+        log("    -d\n");
+        log("        enable debug output\n");
+        log("\n");
+    }
+
+    void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE {
+        log_header(design, "Executing ALS_PREWARM pass (pre-synthesize LUTs in the catalogue).\n");
+        log_push();
+
+        std::string catalogue_path = "catalogue.db";
+        unsigned int arity = 4;
+        unsigned int min_distance = 0;
+        unsigned int max_distance = std::numeric_limits<unsigned int>::max();
+        unsigned int max_tries = 20;
+        unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        bool seen = false;
+        bool debug = false;
+
+        size_t argidx;
+        for (argidx = 1; argidx < args.size(); argidx++) {
+            if (args[argidx] == "-k" && argidx + 1 < args.size()) {
+                arity = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-dist" && argidx + 2 < args.size()) {
+                min_distance = std::stoul(args[++argidx]);
+                max_distance = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-t" && argidx + 1 < args.size()) {
+                max_tries = std::stoul(args[++argidx]);
+            } else if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+                thread_count = std::max(static_cast<unsigned int>(std::stoul(args[++argidx])), 1u);
+            } else if (args[argidx] == "-c" && argidx + 1 < args.size()) {
+                catalogue_path = args[++argidx];
+            } else if (args[argidx] == "-seen") {
+                seen = true;
+            } else if (args[argidx] == "-d") {
+                debug = true;
+            } else {
+                break;
+            }
+        }
+        extra_args(args, argidx, design);
+
+        if (min_distance > max_distance)
+            log_cmd_error("Invalid distance range %u to %u.\n", min_distance, max_distance);
+
+        std::vector<npn_class_t> work;
+        if (seen) {
+            work = seen_functions(design);
+            log("Prewarming %zu functions seen in the selected modules.\n", work.size());
+        } else {
+            if (arity > 4)
+                log_cmd_error("NPN classes can be enumerated up to 4 inputs, use -seen for larger LUTs.\n");
+
+            work = npn_classes(arity);
+            log("Prewarming %zu NPN classes of functions with %u inputs.\n", work.size(), arity);
+        }
+
+        try {
+            Catalogue catalogue(catalogue_path, false);
+            catalogue.write_behind();
+            std::atomic<size_t> next(0);
+            std::atomic<size_t> done(0);
+            std::vector<std::thread> threads;
+
+            // Classes are handed out on demand, as their synthesis time varies a lot
+            for (size_t j = 0; j < thread_count; j++) {
+                threads.emplace_back([&]() {
+                    for (size_t i = next++; i < work.size(); i = next++) {
+                        prewarm(catalogue, work[i], min_distance, max_distance, max_tries, debug);
+
+                        log_mtx.lock();
+                        log("[PREWARM] Completed %zu of %zu.\n", ++done, work.size());
+                        log_mtx.unlock();
+                    }
+                });
+            }
+
+            for (auto &t : threads)
+                t.join();
+
+            if (!catalogue.flush())
+                log_warning("Cannot store some entries in the catalogue %s.\n", catalogue_path.c_str());
+            log("Catalogue now holds %zu entries.\n", catalogue.size());
+        } catch (const std::runtime_error &e) {
+            log_cmd_error("%s\n", e.what());
+        }
+
+        log_pop();
+    }
+
+private:
+    static std::vector<npn_class_t> seen_functions(Design *design) {
+        std::set<Const> unique_luts;
+        for (auto module : design->selected_modules()) {
+            for (auto cell : module->selected_cells()) {
+                if (is_lut(cell))
+                    unique_luts.insert(get_lut_param(cell));
+            }
+        }
+
+        // Each function is a class of its own, with the identity as the only transformation
+        std::vector<npn_class_t> functions;
+        for (auto &lut : unique_luts) {
+            npn_class_t function;
+            function.representative = boost::dynamic_bitset<>(lut.as_string());
+
+            npn_transform_t identity;
+            identity.perm.resize(ceil_log2(function.representative.size()));
+            std::iota(identity.perm.begin(), identity.perm.end(), 0);
+            identity.neg.resize(identity.perm.size(), false);
+            function.members.push_back(identity);
+
+            functions.push_back(function);
+        }
+
+        return functions;
+    }
+
+    static void prewarm(Catalogue &catalogue, const npn_class_t &npn_class, unsigned int min_distance,
+                        unsigned int max_distance, unsigned int max_tries, bool debug) {
+        std::string representative_s;
+        boost::to_string(npn_class.representative, representative_s);
+        auto representative = Const::from_string(representative_s);
+
+        std::vector<std::string> members_s;
+        for (auto &t : npn_class.members) {
+            std::string member_s;
+            boost::to_string(npn_apply(npn_class.representative, t), member_s);
+            members_s.push_back(member_s);
+        }
+
+        for (auto dist = min_distance; dist <= max_distance; dist++) {
+            auto aig = synthesize_lut(representative, dist, max_tries, debug, &catalogue);
+            std::string dist_s = "@" + std::to_string(dist);
+
+            if (!aig.is_valid) {
+                std::vector<std::string> keys;
+                for (auto &member_s : members_s)
+                    keys.push_back(member_s + dist_s);
+                catalogue.insert_timeout(keys, max_tries);
+                break;
+            }
+
+            // Inverters are free, so the transformed models are as good as the synthesized one
+            std::vector<std::pair<std::string, aig_model_t>> entries;
+            for (size_t i = 0; i < npn_class.members.size(); i++) {
+                auto member_aig = npn_apply(aig, npn_class.members[i]);
+                std::string fun_spec;
+                boost::to_string(member_aig.fun_spec, fun_spec);
+                entries.emplace_back(members_s[i] + dist_s, member_aig);
+                entries.emplace_back(fun_spec + "@0", member_aig);
+            }
+
+            if (!catalogue.insert(entries)) {
+                log_mtx.lock();
+                log_warning("Cannot store the class of %s in the catalogue.\n", (representative_s + dist_s).c_str());
+                log_mtx.unlock();
+            }
+
+            if (aig.num_gates == 0 || dist == max_distance)
+                break;
+        }
+    }
+} AlsPrewarmPass;
+
+} // namespace yosys_als
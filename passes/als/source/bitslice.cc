@@ -0,0 +1,147 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Bit-sliced arithmetic on packed simulation words for Yosys ALS module
+ */
+
+#include "bitslice.h"
+
+#include <cmath>
+
+namespace yosys_als {
+
+/*
+ * Exposed methods
+ */
+
+sliced_stats_t::sliced_stats_t(const size_t width) : max(width, false), histogram(width + 1, 0) {}
+
+void sliced_stats_t::add(const sliced_t &x, const uint64_t mask) {
+    if (mask == 0)
+        return;
+
+    // The maximum of the lanes is compared with the running one from the most significant bit
+    auto lanes = sliced_max_lanes(x, mask);
+    auto lane = __builtin_ctzll(lanes);
+    bool greater = false;
+    for (size_t i = x.size(); i-- > 0 && !greater;) {
+        bool bit = (x[i] >> lane) & 1u;
+        if (bit != max[i]) {
+            if (!bit)
+                break;
+            greater = true;
+        }
+    }
+    if (greater) {
+        for (size_t i = 0; i < x.size(); i++)
+            max[i] = (x[i] >> lane) & 1u;
+    }
+
+    // Each lane is counted at its most significant bit, then dropped
+    uint64_t remaining = mask;
+    for (size_t i = x.size(); i-- > 0;) {
+        auto msb = x[i] & remaining;
+        histogram[i + 1] += __builtin_popcountll(msb);
+        remaining &= ~msb;
+        sum += std::ldexp(__builtin_popcountll(x[i] & mask), i);
+    }
+    histogram[0] += __builtin_popcountll(remaining);
+}
+
+double sliced_stats_t::max_value() const {
+    double value = 0.0;
+
+    for (size_t i = 0; i < max.size(); i++) {
+        if (max[i])
+            value += std::ldexp(1.0, i);
+    }
+
+    return value;
+}
+
+sliced_t sliced_abs_difference(const sliced_t &a, const sliced_t &b) {
+    sliced_t d(a.size());
+
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        auto x = a[i] ^ b[i];
+        d[i] = x ^ borrow;
+        borrow = (~a[i] & b[i]) | (~x & borrow);
+    }
+
+    // Lanes with a borrow out are negative, and are negated as one's complement plus one
+    uint64_t carry = borrow;
+    for (size_t i = 0; i < d.size(); i++) {
+        auto x = d[i] ^ borrow;
+        d[i] = x ^ carry;
+        carry &= x;
+    }
+
+    return d;
+}
+
+uint64_t sliced_max_lanes(const sliced_t &x, uint64_t mask) {
+    for (size_t i = x.size(); i-- > 0;) {
+        auto set = x[i] & mask;
+        if (set != 0)
+            mask = set;
+    }
+
+    return mask;
+}
+
+uint64_t sliced_lut(const boost::dynamic_bitset<> &fun_spec, const std::vector<uint64_t> &in_words) {
+    uint64_t word = 0;
+
+    for (size_t entry = 0; entry < fun_spec.size(); entry++) {
+        if (!fun_spec[entry])
+            continue;
+
+        uint64_t minterm = ~uint64_t(0);
+        for (size_t j = 0; j < in_words.size(); j++)
+            minterm &= (entry >> j) & 1u ? in_words[j] : ~in_words[j];
+        word |= minterm;
+    }
+
+    return word;
+}
+
+uint64_t exhaustive_word(const size_t input, const uint64_t block) {
+    static const uint64_t patterns[6] = {0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+                                         0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull};
+
+    return input < 6 ? patterns[input] : ((block >> (input - 6)) & 1u ? ~uint64_t(0) : 0);
+}
+
+std::vector<uint64_t> sliced_toggles(const std::vector<uint64_t> &words, const size_t n) {
+    std::vector<uint64_t> toggles(words.size(), 0);
+
+    // Each bit is compared with the previous one, which is the last bit of the previous word at the borders
+    for (size_t b = 0; b < words.size() && 64 * b < n; b++) {
+        uint64_t previous = (words[b] << 1) | (b > 0 ? words[b - 1] >> 63 : words[b] & 1u);
+        toggles[b] = words[b] ^ previous;
+        if (n - 64 * b < 64)
+            toggles[b] &= (uint64_t(1) << (n - 64 * b)) - 1;
+    }
+
+    return toggles;
+}
+}
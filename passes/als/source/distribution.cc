@@ -0,0 +1,134 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Input distributions for Yosys ALS module
+ */
+
+#include "distribution.h"
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/*
+ * Utility functions and procedures
+ */
+
+/**
+ * @brief Parses a value of a histogram
+ * @return \c false if the value is not a number, otherwise \c true
+ */
+static bool parse_value(const std::string &s, uint64_t &value) {
+    int base = 10;
+    size_t start = 0;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        start = 2;
+    } else if (s.size() > 2 && s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+        base = 2;
+        start = 2;
+    }
+
+    try {
+        size_t end;
+        value = std::stoull(s.substr(start), &end, base);
+        return end == s.size() - start && s[start] != '-';
+    } catch (const std::logic_error &) {
+        return false;
+    }
+}
+
+/*
+ * Exposed functions and procedures
+ */
+
+std::string signal_distribution_t::to_string() const {
+    std::ostringstream os;
+    os.precision(std::numeric_limits<double>::max_digits10);
+
+    os << "distribution " << log_signal(signal);
+    if (histogram.empty()) {
+        os << " probability " << probability;
+    } else {
+        os << " histogram";
+        for (auto &h : histogram)
+            os << " " << h.first << ":" << h.second;
+    }
+
+    return os.str();
+}
+
+bool read_histogram(std::istream &is, const int width, std::vector<std::pair<uint64_t, double>> &histogram) {
+    if (width < 1 || width > 64)
+        return false;
+
+    std::map<uint64_t, double> weights;
+    double total = 0.0;
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream ls(line);
+        std::string value_s;
+        if (!(ls >> value_s) || value_s[0] == '#')
+            continue;
+
+        uint64_t value;
+        if (!parse_value(value_s, value) || (width < 64 && value >> width != 0))
+            return false;
+
+        // Values without a weight are samples of a trace
+        double weight = 1.0;
+        std::string weight_s;
+        if (ls >> weight_s) {
+            try {
+                size_t end;
+                weight = std::stod(weight_s, &end);
+                if (end != weight_s.size())
+                    return false;
+            } catch (const std::logic_error &) {
+                return false;
+            }
+        }
+
+        if (!std::isfinite(weight) || weight < 0.0)
+            return false;
+
+        weights[value] += weight;
+        total += weight;
+    }
+
+    if (!(total > 0.0))
+        return false;
+
+    histogram.clear();
+    for (auto &w : weights) {
+        if (w.second > 0.0)
+            histogram.emplace_back(w.first, w.second);
+    }
+
+    return true;
+}
+}
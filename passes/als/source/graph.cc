@@ -36,7 +36,15 @@ Graph graph_from_module(Module *const module, const Yosys::dict<Yosys::SigBit, d
     Graph g;
     SigMap sigmap(module);
     dict<IdString, vertex_d> vertex_map;
+    dict<SigBit, vertex_d> input_map;
     dict<SigBit, Cell *> driver_of;
+    pool<SigBit> output_bits;
+
+    for (auto wire : module->wires()) {
+        if (wire->port_output)
+            for (auto &bit : sigmap(SigSpec(wire)))
+                output_bits.insert(bit);
+    }
 
     // Iterate on cells, add them as vertices, build driver index
     for (auto cell : module->cells()) {
@@ -56,8 +64,11 @@ Graph graph_from_module(Module *const module, const Yosys::dict<Yosys::SigBit, d
             }
 
             if (cell->output(conn.first))
-                for (auto &sig : sigmap(conn.second))
+                for (auto &sig : sigmap(conn.second)) {
                     driver_of[sig] = cell;
+                    if (output_bits.count(sig))
+                        g.g[v].output = true;
+                }
         }
     }
 
@@ -84,20 +95,20 @@ Graph graph_from_module(Module *const module, const Yosys::dict<Yosys::SigBit, d
                     } else {
                         // Otherwise, driver is a PI
                         if (sig.wire != nullptr) {
-                            // If it's a wire...
-                            auto input = vertex_map.find(sig.wire->name);
+                            // If it's a wire, each of its bits is an input
+                            auto input = input_map.find(sig);
 
-                            if (input == vertex_map.end()) {
+                            if (input == input_map.end()) {
                                 auto v = boost::add_vertex(g.g);
                                 g.num_inputs++;
                                 g.g[v].name = sig.wire->name;
                                 g.g[v].cell = nullptr;
+                                g.g[v].bit = sig;
                                 g.g[v].type = vertex_t::PRIMARY_INPUT;
-                                vertex_map[sig.wire->name] = v;
+                                input_map[sig] = v;
                             }
 
-                            boost::tie(e, b) = boost::add_edge(
-                                    vertex_map[sig.wire->name], vertex_map[cell->name], g.g);
+                            boost::tie(e, b) = boost::add_edge(input_map[sig], vertex_map[cell->name], g.g);
                         } else {
                             // If it's a constant...
                             if (sig.data == State::S1) {
@@ -133,6 +144,12 @@ Graph graph_from_module(Module *const module, const Yosys::dict<Yosys::SigBit, d
         }
     }
 
+    // Cells driving nothing are outputs too, as their values would be lost otherwise
+    for (auto &v : vertex_map) {
+        if (boost::out_degree(v.second, g.g) == 0)
+            g.g[v.second].output = true;
+    }
+
     // TODO Check if BGL implements move semantics - return a pointer otherwise
     return g;
 }
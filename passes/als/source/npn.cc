@@ -0,0 +1,158 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief NPN classification of Boolean functions for Yosys ALS module
+ */
+
+#include "npn.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+namespace yosys_als {
+
+/*
+ * Utility functions and procedures
+ */
+
+/**
+ * @brief Applies an NPN transformation to a truth table packed in an integer
+ */
+static uint64_t npn_apply_packed(const uint64_t f, const unsigned int arity, const npn_transform_t &t) {
+    uint64_t g = 0;
+
+    for (size_t x = 0; x < 1ul << arity; x++) {
+        size_t y = 0;
+        for (size_t i = 0; i < arity; i++) {
+            if (((x >> t.perm[i]) & 1u) != static_cast<size_t>(t.neg[i]))
+                y |= 1ul << i;
+        }
+
+        if (((f >> y) & 1u) != static_cast<uint64_t>(t.out_neg))
+            g |= uint64_t(1) << x;
+    }
+
+    return g;
+}
+
+/**
+ * @brief Enumerates all the NPN transformations for given arity
+ */
+static std::vector<npn_transform_t> npn_transforms(const unsigned int arity) {
+    std::vector<npn_transform_t> transforms;
+    std::vector<size_t> perm(arity);
+    std::iota(perm.begin(), perm.end(), 0);
+
+    do {
+        for (size_t neg_mask = 0; neg_mask < 1ul << arity; neg_mask++) {
+            for (bool out_neg : {false, true}) {
+                npn_transform_t t;
+                t.perm = perm;
+                for (size_t i = 0; i < arity; i++)
+                    t.neg.push_back((neg_mask >> i) & 1u);
+                t.out_neg = out_neg;
+                transforms.push_back(t);
+            }
+        }
+    } while (std::next_permutation(perm.begin(), perm.end()));
+
+    return transforms;
+}
+
+/*
+ * Exposed functions and procedures
+ */
+
+std::vector<npn_class_t> npn_classes(const unsigned int arity) {
+    if (arity > 4)
+        throw std::invalid_argument("NPN enumeration is supported up to 4 inputs.");
+
+    auto transforms = npn_transforms(arity);
+    size_t num_functions = 1ul << (1ul << arity);
+    std::vector<bool> visited(num_functions, false);
+    std::vector<npn_class_t> classes;
+
+    for (uint64_t f = 0; f < num_functions; f++) {
+        if (visited[f])
+            continue;
+
+        // Unvisited functions are the smallest of their class, so they are the representative
+        npn_class_t npn_class;
+        npn_class.representative = boost::dynamic_bitset<>(1ul << arity, f);
+        for (auto &t : transforms) {
+            auto g = npn_apply_packed(f, arity, t);
+            if (!visited[g]) {
+                visited[g] = true;
+                npn_class.members.push_back(t);
+            }
+        }
+
+        classes.push_back(std::move(npn_class));
+    }
+
+    return classes;
+}
+
+boost::dynamic_bitset<> npn_apply(const boost::dynamic_bitset<> &fun_spec, const npn_transform_t &t) {
+    auto arity = t.perm.size();
+    boost::dynamic_bitset<> g(fun_spec.size());
+
+    for (size_t x = 0; x < g.size(); x++) {
+        size_t y = 0;
+        for (size_t i = 0; i < arity; i++) {
+            if (((x >> t.perm[i]) & 1u) != static_cast<size_t>(t.neg[i]))
+                y |= 1ul << i;
+        }
+
+        g[x] = fun_spec[y] != t.out_neg;
+    }
+
+    return g;
+}
+
+aig_model_t npn_apply(const aig_model_t &aig, const npn_transform_t &t) {
+    aig_model_t result = aig;
+
+    // Variable i + 1 of the original model is input i (variable 0 is the constant)
+    auto map_var = [&t](size_t &var, bool &p) {
+        if (var > 0 && var <= t.perm.size()) {
+            p = p != t.neg[var - 1];
+            var = t.perm[var - 1] + 1;
+        }
+    };
+
+    for (size_t i = aig.num_inputs; i < result.s.size(); i++) {
+        for (size_t c = 0; c < 2; c++) {
+            bool p = result.p[i][c];
+            map_var(result.s[i][c], p);
+            result.p[i][c] = p;
+        }
+    }
+
+    map_var(result.out, result.out_p);
+    result.out_p = result.out_p != t.out_neg;
+    result.fun_spec = npn_apply(aig.fun_spec, t);
+
+    return result;
+}
+}
@@ -0,0 +1,191 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Partitioning of modules in windows for Yosys ALS module
+ */
+
+#include "partition.h"
+#include "graph.h"
+#include "kernel/sigtools.h"
+
+#include <boost/graph/topological_sort.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+std::vector<std::vector<IdString>> partition_module(Module *const module, const size_t window_size) {
+    auto g = graph_from_module(module, dict<SigBit, double>());
+    std::vector<vertex_d> vertices;
+    boost::topological_sort(g.g, std::back_inserter(vertices));
+    std::reverse(vertices.begin(), vertices.end());
+
+    // A LUT is one level above the deepest LUT driving it
+    std::vector<size_t> level(boost::num_vertices(g.g), 0);
+    std::vector<std::vector<vertex_d>> by_level;
+    for (auto v : vertices) {
+        if (g.g[v].type != vertex_t::CELL)
+            continue;
+
+        boost::graph_traits<graph_t>::in_edge_iterator e, e_end;
+        for (boost::tie(e, e_end) = boost::in_edges(v, g.g); e != e_end; ++e) {
+            auto u = boost::source(*e, g.g);
+            if (g.g[u].type == vertex_t::CELL)
+                level[v] = std::max(level[v], level[u] + 1);
+        }
+
+        if (level[v] >= by_level.size())
+            by_level.resize(level[v] + 1);
+        by_level[level[v]].push_back(v);
+    }
+
+    // The output of a LUT crosses the cut after each level from its own to the one before its deepest fanout
+    std::vector<long> cut(by_level.size() + 1, 0);
+    for (auto v : vertices) {
+        if (g.g[v].type != vertex_t::CELL)
+            continue;
+
+        size_t deepest = level[v];
+        boost::graph_traits<graph_t>::out_edge_iterator e, e_end;
+        for (boost::tie(e, e_end) = boost::out_edges(v, g.g); e != e_end; ++e)
+            deepest = std::max(deepest, level[boost::target(*e, g.g)]);
+
+        if (deepest > level[v]) {
+            cut[level[v]]++;
+            cut[deepest]--;
+        }
+    }
+    for (size_t l = 1; l < cut.size(); l++)
+        cut[l] += cut[l - 1];
+
+    std::vector<std::vector<IdString>> windows;
+    size_t first = 0;
+    while (first < by_level.size()) {
+        // A level larger than a window is split, as its LUTs do not drive each other
+        if (by_level[first].size() > window_size) {
+            for (size_t i = 0; i < by_level[first].size(); i += window_size) {
+                windows.emplace_back();
+                for (size_t j = i; j < std::min(i + window_size, by_level[first].size()); j++)
+                    windows.back().push_back(g.g[by_level[first][j]].name);
+            }
+            first++;
+            continue;
+        }
+
+        // Extend the band while it fits, and end it at the smallest cut once it is half full
+        size_t size = 0;
+        size_t last;
+        size_t best = first;
+        long best_cut = std::numeric_limits<long>::max();
+        for (last = first; last < by_level.size() && size + by_level[last].size() <= window_size; last++) {
+            size += by_level[last].size();
+            if (2 * size >= window_size && cut[last] <= best_cut) {
+                best_cut = cut[last];
+                best = last;
+            }
+        }
+
+        // The last band, or a band that is never half full, takes all the levels that fit
+        if (last == by_level.size() || best_cut == std::numeric_limits<long>::max())
+            best = last - 1;
+
+        windows.emplace_back();
+        for (size_t l = first; l <= best; l++) {
+            for (auto v : by_level[l])
+                windows.back().push_back(g.g[v].name);
+        }
+        first = best + 1;
+    }
+
+    return windows;
+}
+
+Module *extract_window(Design *const design, const IdString name, Module *const module,
+                       const std::vector<IdString> &cells) {
+    SigMap sigmap(module);
+    auto window = design->addModule(name);
+    dict<SigBit, SigBit> bit_map;
+    pool<IdString> inside(cells.begin(), cells.end());
+
+    // Signals read by the rest of the module, or by its environment, are observed outside the window
+    pool<SigBit> used_outside;
+    for (auto wire : module->wires()) {
+        if (wire->port_output)
+            for (auto bit : sigmap(SigSpec(wire)))
+                used_outside.insert(bit);
+    }
+    for (auto cell : module->cells()) {
+        if (inside.count(cell->name))
+            continue;
+        for (auto &conn : cell->connections()) {
+            if (cell->input(conn.first))
+                for (auto bit : sigmap(conn.second))
+                    used_outside.insert(bit);
+        }
+    }
+
+    for (auto &cell_name : cells) {
+        auto cell = module->cell(cell_name);
+        auto copy = window->addCell(cell->name, cell);
+
+        // Each signal of the module is a wire of one bit in the window, constants are kept
+        for (auto &conn : cell->connections()) {
+            SigSpec sig;
+            for (auto bit : sigmap(conn.second)) {
+                if (bit.wire != nullptr) {
+                    auto mapped = bit_map.find(bit);
+                    if (mapped == bit_map.end()) {
+                        bit_map[bit] = window->addWire(NEW_ID);
+                        mapped = bit_map.find(bit);
+                    }
+                    bit = mapped->second;
+                }
+                sig.append(bit);
+            }
+            copy->setPort(conn.first, sig);
+        }
+    }
+
+    // Cut signals are the ports of the window, so that the evaluators observe those driven inside it
+    pool<SigBit> driven;
+    for (auto &cell_name : cells) {
+        auto cell = module->cell(cell_name);
+        for (auto &conn : cell->connections()) {
+            if (cell->output(conn.first))
+                for (auto bit : sigmap(conn.second))
+                    driven.insert(bit);
+        }
+    }
+    for (auto &mapped : bit_map) {
+        if (!driven.count(mapped.first))
+            mapped.second.wire->port_input = true;
+        else if (used_outside.count(mapped.first))
+            mapped.second.wire->port_output = true;
+    }
+    window->fixup_ports();
+
+    return window;
+}
+}
@@ -234,6 +234,7 @@ aig_model_t synthesize_lut(const boost::dynamic_bitset<> &fun_spec, const unsign
         aig.out_p = *sel_var % 2 == 0;
         aig.fun_spec = truth_table_column(aig.out, num_vars, aig.out_p);
         aig.is_valid = true;
+        aig.is_optimal = true;
         return aig;
     }
 
@@ -255,11 +256,19 @@ aig_model_t synthesize_lut(const boost::dynamic_bitset<> &fun_spec, const unsign
     // Function semantics
     assume_function_semantics(ctx);
 
-    // Solver loop
+    // Solver loop: a model is proven minimal only if every smaller instance was proven unsatisfiable,
+    // so an instance the solver gives up on is skipped, and the model found later is just the best one
     unsigned int tries = 0;
-    while (boolector_sat(ctx.btor) == BOOLECTOR_UNSAT) {
-        if (out_distance > 0 && tries >= max_tries)
+    bool proven = true;
+    int result;
+    while ((result = boolector_sat(ctx.btor)) != BOOLECTOR_SAT) {
+        if (result != BOOLECTOR_UNSAT)
+            proven = false;
+
+        if (out_distance > 0 && tries >= max_tries) {
+            smt_context_delete(ctx);
             return aig;
+        }
 
         // Update index
         auto i = ctx.b.size();
@@ -329,7 +338,30 @@ aig_model_t synthesize_lut(const boost::dynamic_bitset<> &fun_spec, const unsign
     // Delete solver
     smt_context_delete(ctx);
 
+    // Gates are added one at a time, so the first satisfiable instance is minimal if no smaller one was skipped
     aig.is_valid = true;
+    aig.is_optimal = proven;
     return aig;
 }
+
+boost::dynamic_bitset<> simulate_aig(const aig_model_t &aig) {
+    auto num_vars = aig.num_inputs - 1;
+    boost::dynamic_bitset<> fun(1u << num_vars);
+
+    for (size_t t = 0; t < fun.size(); t++) {
+        std::vector<bool> b;
+        for (size_t i = 0; i < aig.num_inputs; i++)
+            b.push_back(truth_table_value(i, t));
+
+        for (size_t i = aig.num_inputs; i < aig.s.size(); i++) {
+            bool in_0 = b[aig.s[i][0]] == aig.p[i][0];
+            bool in_1 = b[aig.s[i][1]] == aig.p[i][1];
+            b.push_back(in_0 && in_1);
+        }
+
+        fun[t] = b[aig.out] == aig.out_p;
+    }
+
+    return fun;
+}
 } // namespace yosys_als
@@ -0,0 +1,236 @@
+/* -*- c++ -*-
+ *  yosys-als -- Approximate logic synthesis
+ *
+ *  Copyright (C) 2021  Alberto Moriconi <albmoriconi@gmail.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Sets of circuit variants for Yosys ALS module
+ */
+
+#include "variants.h"
+#include "yosys_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <set>
+
+USING_YOSYS_NAMESPACE
+
+namespace yosys_als {
+
+/*
+ * Utility functions and procedures
+ */
+
+/**
+ * @brief Quotes a string for JSON
+ */
+static std::string json_quote(const std::string &s) {
+    std::string quoted = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[7];
+            snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned char>(c));
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/**
+ * @brief Quotes a string for CSV
+ */
+static std::string csv_quote(const std::string &s) {
+    std::string quoted = "\"";
+    for (auto c : s) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/*
+ * Exposed functions and procedures
+ */
+
+void write_variant_set(std::ostream &os, const std::vector<variant_t> &variants) {
+    os << std::setprecision(std::numeric_limits<double>::max_digits10) << variants.size() << "\n";
+
+    for (auto &variant : variants) {
+        os << variant.luts.size() << " " << variant.value[0] << " " << variant.value[1] << " " << variant.gates
+           << " " << variant.samples << " " << variant.exhaustive << " " << variant.error_bounds[0] << " "
+           << variant.error_bounds[1] << " " << variant.power << "\n";
+        for (auto &lut : variant.luts)
+            os << lut.first.str() << " " << variant.levels.at(lut.first) << " " << lut.second.as_string() << "\n";
+    }
+}
+
+bool read_variant_set(std::istream &is, std::vector<variant_t> &variants) {
+    size_t num_variants;
+    if (!(is >> num_variants))
+        return false;
+
+    variants.clear();
+    for (size_t i = 0; i < num_variants; i++) {
+        variant_t variant;
+        size_t num_luts;
+        if (!(is >> num_luts >> variant.value[0] >> variant.value[1] >> variant.gates >> variant.samples >>
+              variant.exhaustive >> variant.error_bounds[0] >> variant.error_bounds[1] >> variant.power))
+            return false;
+
+        for (size_t j = 0; j < num_luts; j++) {
+            std::string name, spec;
+            size_t level;
+            if (!(is >> name >> level >> spec))
+                return false;
+            variant.levels[name] = level;
+            variant.luts[name] = Const::from_string(spec);
+        }
+
+        variants.push_back(variant);
+    }
+
+    return true;
+}
+
+std::array<double, 2> wilson_bounds(const size_t errors, const size_t samples, const double z) {
+    if (samples == 0)
+        return {{0.0, 1.0}};
+
+    double n = samples;
+    double e = static_cast<double>(errors) / n;
+    double center = (e + z * z / (2 * n)) / (1 + z * z / n);
+    double half_width = z / (1 + z * z / n) * std::sqrt(e * (1 - e) / n + z * z / (4 * n * n));
+
+    return {{std::max(center - half_width, 0.0), std::min(center + half_width, 1.0)}};
+}
+
+double normal_quantile(const double alpha) {
+    // P(|Z| > z) = erfc(z / sqrt(2)) decreases with z, so bisection converges to it
+    double low = 0.0;
+    double high = 40.0;
+    for (int i = 0; i < 100; i++) {
+        double mid = (low + high) / 2;
+        if (std::erfc(mid / std::sqrt(2.0)) > alpha)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return (low + high) / 2;
+}
+
+std::string variant_file_name(const size_t entry) {
+    return "variant_" + std::to_string(entry + 1);
+}
+
+void write_archive_json(std::ostream &os, const std::string &module_name, const std::string &metric,
+                        const std::vector<variant_t> &variants) {
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    os << "{\n  \"module\": " << json_quote(module_name) << ",\n  \"metric\": " << json_quote(metric)
+       << ",\n  \"variants\": [";
+
+    for (size_t i = 0; i < variants.size(); i++) {
+        auto &variant = variants[i];
+        os << (i > 0 ? ",\n" : "\n") << "    {\n"
+           << "      \"entry\": " << i << ",\n"
+           << "      \"file\": " << json_quote(variant_file_name(i)) << ",\n"
+           << "      \"error\": " << variant.value[0] << ",\n"
+           << "      \"error_bounds\": [" << variant.error_bounds[0] << ", " << variant.error_bounds[1] << "],\n"
+           << "      \"samples\": " << variant.samples << ",\n"
+           << "      \"exhaustive\": " << (variant.exhaustive ? "true" : "false") << ",\n"
+           << "      \"gates\": " << variant.gates << ",\n"
+           << "      \"gates_ratio\": " << variant.value[1] << ",\n"
+           << "      \"power_ratio\": " << variant.power << ",\n"
+           << "      \"lut6\": ";
+        if (variant.estimated)
+            os << "{\"count\": " << variant.lut6_count << ", \"depth\": " << variant.lut6_depth << "}";
+        else
+            os << "null";
+        os << ",\n"
+           << "      \"luts\": {";
+
+        bool first = true;
+        for (auto &lut : variant.luts) {
+            os << (first ? "\n" : ",\n") << "        " << json_quote(lut.first.str()) << ": {\"level\": "
+               << variant.levels.at(lut.first) << ", \"spec\": " << json_quote(lut.second.as_string()) << "}";
+            first = false;
+        }
+        os << (first ? "}\n" : "\n      }\n") << "    }";
+    }
+
+    os << (variants.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+void write_archive_csv(std::ostream &os, const std::vector<variant_t> &variants) {
+    // All the variants choose a level for the same LUTs, but we do not rely on it
+    std::set<std::string> cells;
+    for (auto &variant : variants)
+        for (auto &level : variant.levels)
+            cells.insert(level.first.str());
+
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    os << "entry,file,error,error_lower,error_upper,samples,exhaustive,gates,gates_ratio,power_ratio,lut6_count,lut6_depth";
+    for (auto &cell : cells)
+        os << "," << csv_quote(cell);
+    os << "\n";
+
+    for (size_t i = 0; i < variants.size(); i++) {
+        auto &variant = variants[i];
+        os << i << "," << variant_file_name(i) << "," << variant.value[0] << "," << variant.error_bounds[0] << ","
+           << variant.error_bounds[1] << "," << variant.samples << "," << variant.exhaustive << ","
+           << variant.gates << "," << variant.value[1] << "," << variant.power;
+        if (variant.estimated)
+            os << "," << variant.lut6_count << "," << variant.lut6_depth;
+        else
+            os << ",,";
+        for (auto &cell : cells) {
+            auto level = variant.levels.find(IdString(cell));
+            os << ",";
+            if (level != variant.levels.end())
+                os << level->second;
+        }
+        os << "\n";
+    }
+}
+
+size_t apply_variant(Module *module, const variant_t &variant) {
+    size_t mismatches = 0;
+
+    for (auto &lut : variant.luts) {
+        auto cell = module->cell(lut.first);
+        if (cell == nullptr || !is_lut(cell) || get_lut_param(cell).size() != lut.second.size()) {
+            mismatches++;
+            continue;
+        }
+
+        cell->setParam("\\LUT", lut.second);
+    }
+
+    return mismatches;
+}
+}
@@ -26,87 +26,26 @@
 
 #include "smtsynth.h"
 
-#include <boost/archive/text_oarchive.hpp>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/array.hpp>
-
+#include <cerrno>
+#include <cstring>
 #include <mutex>
 #include <random>
+#include <thread>
 
-USING_YOSYS_NAMESPACE
-
-namespace boost {
-namespace serialization {
-
-template<class Archive>
-void serialize(Archive &ar, yosys_als::aig_model_t &aig,
-               const unsigned int version __attribute__((unused))) {
-    ar & aig.is_valid;
-    ar & aig.fun_spec;
-    ar & aig.num_inputs;
-    ar & aig.num_gates;
-    ar & aig.s;
-    ar & aig.p;
-    ar & aig.out;
-    ar & aig.out_p;
-}
-
-template<typename Ar, typename Block, typename Alloc>
-void save(Ar &ar, dynamic_bitset<Block, Alloc> const &bs, unsigned) {
-    size_t num_bits = bs.size();
-    std::vector<Block> blocks(bs.num_blocks());
-    to_block_range(bs, blocks.begin());
-
-    ar & num_bits & blocks;
-}
-
-template<typename Ar, typename Block, typename Alloc>
-void load(Ar &ar, dynamic_bitset<Block, Alloc> &bs, unsigned) {
-    size_t num_bits;
-    std::vector<Block> blocks;
-    ar & num_bits & blocks;
-
-    bs.resize(num_bits);
-    from_block_range(blocks.begin(), blocks.end(), bs);
-    bs.resize(num_bits);
-}
-
-template<typename Ar, typename Block, typename Alloc>
-void serialize(Ar &ar, dynamic_bitset<Block, Alloc> &bs, unsigned version) {
-    split_free(ar, bs, version);
-}
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-}
-}
+USING_YOSYS_NAMESPACE
 
 namespace yosys_als {
 
-std::default_random_engine rng{std::random_device{}()};
-std::mutex db_mtx;
+thread_local std::default_random_engine rng{std::random_device{}()};
 std::mutex log_mtx;
 
-struct aig_bundle_t {
-    aig_model_t *aig;
-    bool hit;
-};
-
 // TODO Needs refactoring
 aig_model_t synthesize_lut(const Const &lut, unsigned int out_distance = 0, unsigned int max_tries = 20,
-                           bool debug = false, sqlite3 *db = nullptr) {
-
-    // Database initialization
-    if (db != nullptr) {
-        db_mtx.lock();
-        if (sqlite3_table_column_metadata(db, 0, "luts", 0, 0, 0, 0, 0, 0) != SQLITE_OK) {
-            std::string query = "create table luts (spec text not null, aig blob not null, primary key (spec));";
-            sqlite3_exec(db, query.c_str(), 0, 0, 0);
-            if (debug)
-                log("Initialized cache\n");
-        }
-        db_mtx.unlock();
-    }
-
+                           bool debug = false, Catalogue *catalogue = nullptr) {
     if (debug) {
         log_mtx.lock();
         log("[SYNTH] Requested synthesis for %s@%d.\n", lut.as_string().c_str(), out_distance);
@@ -114,32 +53,35 @@ aig_model_t synthesize_lut(const Const &lut, unsigned int out_distance = 0, unsi
     }
 
     aig_model_t aig;
-    aig_bundle_t aig_bundle{&aig, false};
     string fun_spec;
 
     // Cache lookup
-    if (db != nullptr) {
+    if (catalogue != nullptr) {
         std::string key = lut.as_string() + "@" + std::to_string(out_distance);
-        std::string query = "select aig from luts where spec = '" + key + "';";
-        sqlite3_exec(db, query.c_str(),
-                     [](void *aig_bundle, int argc, char **argv, char **azColName) { // Cache hit
-                         (void) argc;
-                         (void) azColName;
 
-                         auto *the_bundle = (aig_bundle_t *) aig_bundle;
-                         std::istringstream is(argv[0]);
-                         boost::archive::text_iarchive ia(is);
+        bool hit = catalogue->lookup(key, aig);
+        bool known_timeout = !hit && catalogue->timed_out(key, max_tries);
 
-                         ia >> *(the_bundle->aig);
-                         the_bundle->hit = true;
+        // Another process may be synthesizing the same entry: wait for its result
+        bool claimed = false;
+        while (!hit && !known_timeout && !(claimed = catalogue->claim(key))) {
+            hit = catalogue->wait_for(key, aig);
+            known_timeout = !hit && catalogue->timed_out(key, max_tries);
+        }
 
-                         return 0;
-                     }, (void *) &aig_bundle, 0);
+        // The entry may have been stored after our index was loaded
+        if (claimed) {
+            hit = catalogue->fetch(key, aig);
+            known_timeout = !hit && catalogue->timed_out(key, max_tries);
+        }
 
-        if (!aig_bundle.hit) { // Cache miss, synth and insert in cache
-            std::ostringstream os;
-            boost::archive::text_oarchive oa(os);
+        catalogue->count(key, hit || known_timeout);
 
+        if (known_timeout) { // Negative hit, don't retry with the same budget
+            log_mtx.lock();
+            log("[CACHE] Known time-out for %s with %u tries.\n", key.c_str(), max_tries);
+            log_mtx.unlock();
+        } else if (!hit) { // Cache miss, synth and insert in cache
             log_mtx.lock();
             log("[CACHE] Cache miss for %s.\n", key.c_str());
             log_mtx.unlock();
@@ -147,20 +89,25 @@ aig_model_t synthesize_lut(const Const &lut, unsigned int out_distance = 0, unsi
             aig = yosys_als::synthesize_lut(boost::dynamic_bitset<>(lut.as_string()), out_distance, max_tries);
 
             if (aig.is_valid) {
-                oa << aig;
-
-                std::string query_ins = "insert into luts values ('" + key + "', '" + os.str() + "');";
-                sqlite3_exec(db, query_ins.c_str(), 0, 0, 0);
+                // A minimal model is minimal for the function it implements too, as any exact
+                // implementation of that function is within distance from the specification
                 boost::to_string(aig.fun_spec, fun_spec);
-                std::string key_replace = fun_spec + "@0";
-                query_ins = "insert into luts values ('" + key_replace + "', '" + os.str() + "');";
-                sqlite3_exec(db, query_ins.c_str(), 0, 0, 0);
+                if (!catalogue->insert({{key, aig}, {fun_spec + "@0", aig}})) {
+                    log_mtx.lock();
+                    log_warning("Cannot store %s in the catalogue.\n", key.c_str());
+                    log_mtx.unlock();
+                }
+            } else {
+                catalogue->insert_timeout(key, max_tries);
             }
         } else {
             log_mtx.lock();
             log("[CACHE] Cache hit for %s.\n", key.c_str());
             log_mtx.unlock();
         }
+
+        if (claimed)
+            catalogue->release(key);
     } else {
         aig = yosys_als::synthesize_lut(boost::dynamic_bitset<>(lut.as_string()), out_distance, max_tries);
     }
@@ -182,4 +129,114 @@ aig_model_t synthesize_lut(const Const &lut, unsigned int out_distance = 0, unsi
 
     return aig;
 }
+
+void run_forked(const std::vector<std::string> &names, const std::function<std::string(size_t)> &task,
+                const std::function<void(size_t, const std::string &)> &done, unsigned int worker_count, bool fatal) {
+    if (worker_count == 0)
+        worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+    log_flush();
+
+    struct worker_t {
+        pid_t pid;
+        size_t task;
+        int fd;
+        std::string output;
+    };
+    std::vector<worker_t> workers;
+    std::vector<std::string> errors;
+    size_t next = 0;
+    while (next < names.size() || !workers.empty()) {
+        if (next < names.size() && workers.size() < worker_count) {
+            int fds[2];
+            if (pipe(fds) != 0)
+                log_error("Cannot start worker: %s\n", strerror(errno));
+            pid_t pid = fork();
+            if (pid < 0)
+                log_error("Cannot start worker: %s\n", strerror(errno));
+
+            if (pid == 0) {
+                // Logs of concurrent workers would interleave
+                close(fds[0]);
+                log_files.clear();
+                log_streams.clear();
+
+                // The first byte tells a result from an error message
+                std::string output;
+                try {
+                    output = "+" + task(next);
+                } catch (const std::exception &e) {
+                    output = std::string("-") + e.what();
+                } catch (...) {
+                    // Yosys command errors are not standard exceptions
+                    output = "-task aborted";
+                }
+
+                const char *p = output.data();
+                size_t left = output.size();
+                while (left > 0) {
+                    auto n = write(fds[1], p, left);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                        _exit(1);
+                    p += n;
+                    left -= n;
+                }
+                _exit(0);
+            }
+
+            close(fds[1]);
+            workers.push_back({pid, next, fds[0], std::string()});
+            next++;
+            continue;
+        }
+
+        // Pipes are drained as they fill, so that no worker blocks on a large result
+        std::vector<pollfd> fds;
+        for (auto &w : workers)
+            fds.push_back({w.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            log_error("Cannot wait for workers: %s\n", strerror(errno));
+        }
+
+        for (size_t i = fds.size(); i-- > 0;) {
+            if (fds[i].revents == 0)
+                continue;
+
+            auto &w = workers[i];
+            char buffer[65536];
+            auto n = read(w.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                w.output.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            close(w.fd);
+            int status;
+            while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+                ;
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || w.output.empty())
+                errors.push_back(names[w.task] + ": worker terminated abnormally");
+            else if (w.output[0] == '-')
+                errors.push_back(names[w.task] + ": " + w.output.substr(1));
+            else
+                done(w.task, w.output.substr(1));
+            workers.erase(workers.begin() + i);
+        }
+    }
+
+    if (!errors.empty()) {
+        std::string message;
+        for (auto &e : errors)
+            message += "  " + e + "\n";
+        if (fatal)
+            log_error("%zu of %zu tasks failed:\n%s", errors.size(), names.size(), message.c_str());
+        log_warning("%zu of %zu tasks failed:\n%s", errors.size(), names.size(), message.c_str());
+    }
+}
 }
@@ -27,13 +27,9 @@ yosys hierarchy -check -top $module_name
 # Approximate logic synthesis
 yosys splitnets -ports
 yosys als -d
-yosys delete
 
-# Save results
-file mkdir als_${module_name}_replaced
-foreach file [glob -directory als_${module_name} *.ilang] {
-    yosys read_ilang $file
-    yosys als -d -r
-    yosys write_verilog als_${module_name}_replaced/[file tail [file rootname $file]].v
-    yosys delete
-}
+# Save results
+yosys als_apply -all -rewrite -verilog -o als_${module_name}_replaced
+yosys als -d -r
+yosys write_verilog als_${module_name}_replaced/exact.v
+yosys delete